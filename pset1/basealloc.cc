@@ -1,95 +1,1152 @@
 #define M61_DISABLE 1
 #include "m61.hh"
-#include <unordered_map>
+#include <cstring>
+#include <algorithm>
+#include <new>
 #include <vector>
+#include <atomic>
+#include <mutex>
 #include <sys/mman.h>
 
+#if M61_PRELOAD
+// In libm61.so, malloc() and friends are m61 itself; the base allocator
+// takes its memory from the system allocator behind it.
+#define malloc(sz)          m61_real_malloc((sz))
+#define calloc(nmemb, sz)   m61_real_calloc((nmemb), (sz))
+#define free(ptr)           m61_real_free((ptr))
+#define posix_memalign(pptr, align, sz) m61_real_posix_memalign((pptr), (align), (sz))
+#endif
+
 
 // This file contains a base memory allocator guaranteed not to
 // overwrite freed allocations. No need to understand it.
 
 
-using base_allocation = std::pair<uintptr_t, size_t>;
+// Every request is rounded up to a size class. Classes run in quarter
+// steps between powers of two: 16, 20, 24, 28, 32, 40, 48, 56, 64, 80, ...
+// Each class keeps its own FIFO of freed blocks, so reuse is O(1) and a
+// freed block is only handed out again after every block freed before it
+// in the same class, and only once `BASE_REUSE_DELAY` younger blocks have
+// queued up behind it.
 
-// `allocs` is a hash table mapping active pointer address to allocation size.
-// `frees` is a vector of freed allocations.
-static std::unordered_map<uintptr_t, size_t> allocs;
-static std::vector<base_allocation> frees;
-static int disabled;
+#define BASE_MIN_CLASS_SIZE 16
+#define BASE_NCLASSES       (4 * (62 - 4) + 1)
+#define BASE_REUSE_DELAY    4
 
-static unsigned alloc_random() {
-    static uint64_t x = 8973443640547502487ULL;
-    x = x * 6364136223846793005ULL + 1ULL;
-    return x >> 32;
+static inline int base_size_class(size_t sz) {
+    if (sz <= BASE_MIN_CLASS_SIZE) {
+        return 0;
+    }
+    // 2^p < sz <= 2^(p+1); quarter steps are 2^(p-2) bytes
+    int p = 63 - __builtin_clzll(sz - 1);
+    size_t step = size_t(1) << (p - 2);
+    int q = (sz - (size_t(1) << p) + step - 1) >> (p - 2);
+    return 4 * (p - 4) + q;
 }
 
-static void base_allocator_atexit();
+static inline size_t base_class_size(int c) {
+    int p = 4 + c / 4;
+    return (size_t(1) << p) + (c % 4) * (size_t(1) << (p - 2));
+}
 
-void* base_malloc(size_t sz) {
-    if (disabled) {
-        return malloc(sz);
+
+// base_fifo: a growable ring buffer of freed block addresses. Links are
+// kept here, not in the freed blocks, so freed data stays untouched. If
+// the buffer cannot grow, `push` fails, and the caller forgets the block:
+// it is never reused, but the allocator keeps working.
+struct base_fifo {
+    uintptr_t* slots = nullptr;
+    size_t capacity = 0;        // always 0 or a power of 2
+    size_t head = 0;            // index of oldest entry
+    size_t size = 0;
+
+    bool push(uintptr_t addr) {
+        if (size == capacity && !grow()) {
+            return false;
+        }
+        slots[(head + size) & (capacity - 1)] = addr;
+        ++size;
+        return true;
+    }
+    uintptr_t front() const {
+        return slots[head];
+    }
+    uintptr_t pop() {
+        uintptr_t addr = slots[head];
+        head = (head + 1) & (capacity - 1);
+        --size;
+        return addr;
+    }
+    bool grow() {
+        size_t ncapacity = capacity ? capacity * 2 : 16;
+        uintptr_t* nslots = reinterpret_cast<uintptr_t*>(
+            malloc(ncapacity * sizeof(uintptr_t)));
+        if (!nslots) {
+            return false;
+        }
+        for (size_t i = 0; i != size; ++i) {
+            nslots[i] = slots[(head + i) & (capacity - 1)];
+        }
+        free(slots);
+        slots = nslots;
+        capacity = ncapacity;
+        head = 0;
+        return true;
+    }
+};
+
+
+// Threads free into their own `base_cache`, so a malloc/free pair touches
+// no shared free list. A class that holds more than `BASE_CACHE_LIMIT`
+// blocks spills its oldest half into the shared per-class depot, and a
+// thread with no aged block of its own refills from the depot before
+// asking the system for new memory. Depot classes are locked separately;
+// there is no global lock.
+//
+// A cache outlives its thread: at thread exit its blocks move to the depot
+// and the empty cache (with its counters) is claimed by the next new thread.
+
+#define BASE_CACHE_LIMIT    32
+
+struct base_cache {
+    base_fifo frees[BASE_NCLASSES];
+    std::atomic<unsigned long long> nreuse{0};
+    std::atomic<unsigned long long> nfresh{0};
+    std::atomic<unsigned long long> granted_size{0}; // bytes in active blocks
+    std::atomic<unsigned long long> free_size{0};   // bytes in `frees`
+    std::atomic<uint64_t> nonempty[(BASE_NCLASSES + 63) / 64] = {};
+    uintptr_t slab_next = 0;            // fresh small blocks come from here
+    uintptr_t slab_end = 0;
+    unsigned nfree_unchecked = 0;       // frees since the last reclaim check
+    std::atomic<bool> owned{true};
+    base_cache* next = nullptr;
+};
+
+struct base_depot_class {
+    std::mutex lock;
+    std::atomic<size_t> size{0};    // read without the lock as a hint
+    base_fifo frees;
+};
+
+// base_table: open-addressing hash table mapping active block address to
+// allocation size. Linear probing with backward-shift deletion, so there
+// are no tombstones; it stays at most half full and allocates only when
+// it doubles.
+struct base_table {
+    struct slot {
+        uintptr_t addr;                 // 0 marks an empty slot
+        size_t size;
+    };
+    slot* slots = nullptr;
+    size_t capacity = 0;                // 0 or a power of 2
+    size_t n = 0;
+
+    static size_t hash(uintptr_t addr) {
+        return (addr * 0x9E3779B97F4A7C15ULL) >> 32;
+    }
+    // return the slot holding `addr`, or the empty slot where it belongs
+    slot* find(uintptr_t addr) {
+        size_t i = hash(addr);
+        while (true) {
+            i &= capacity - 1;
+            if (slots[i].addr == addr || slots[i].addr == 0) {
+                return &slots[i];
+            }
+            ++i;
+        }
+    }
+    slot* lookup(uintptr_t addr) {
+        slot* s = capacity ? find(addr) : nullptr;
+        return s && s->addr ? s : nullptr;
+    }
+    void insert(uintptr_t addr, size_t sz) {
+        if (2 * (n + 1) > capacity) {
+            grow();
+        }
+        slot* s = find(addr);
+        n += s->addr == 0;
+        *s = {addr, sz};
+    }
+    void erase(slot* s) {
+        size_t i = s - slots;
+        slots[i].addr = 0;
+        --n;
+        for (size_t j = (i + 1) & (capacity - 1); slots[j].addr != 0;
+             j = (j + 1) & (capacity - 1)) {
+            size_t home = hash(slots[j].addr) & (capacity - 1);
+            // move entry `j` back unless its home lies cyclically in (i, j]
+            if ((i < j && (home <= i || home > j))
+                || (i > j && home <= i && home > j)) {
+                slots[i] = slots[j];
+                slots[j].addr = 0;
+                i = j;
+            }
+        }
+    }
+    void grow() {
+        slot* oslots = slots;
+        size_t ocapacity = capacity;
+        capacity = capacity ? capacity * 2 : 256;
+        slots = reinterpret_cast<slot*>(calloc(capacity, sizeof(slot)));
+        for (size_t i = 0; i != ocapacity; ++i) {
+            if (oslots[i].addr) {
+                *find(oslots[i].addr) = oslots[i];
+            }
+        }
+        free(oslots);
+    }
+};
+
+// `allocs` maps active pointer address to allocation size. It is split
+// into `BASE_NSHARDS` independently locked shards by address.
+#define BASE_NSHARDS        64
+
+struct base_alloc_shard {
+    std::mutex lock;
+    base_table allocs;
+} __attribute__((aligned(64)));
+
+// The heap is a set of regions of reserved address space, each a
+// multiple of `BASE_REGION_SIZE` bytes and aligned to that size. A region
+// starts with a header and a chunk bitmap holding one bit per 16 bytes,
+// set at the start of every active block. Blocks are carved from the rest
+// of the region in address order; reserved memory stays inaccessible
+// until it is carved. `base_regions`, indexed by address divided by
+// `BASE_REGION_SIZE`, maps every address to its region, so
+// `base_classify` places any pointer outside the heap, at a block start,
+// or elsewhere in the heap with two loads and a bit test. Regions are
+// never unmapped.
+//
+// Each thread carves fresh small blocks from its own `BASE_SLAB_SIZE`
+// slab, so the region lock is taken once per slab. Slabs are aligned to
+// their size, and the region header keeps a `base_slab` record for each
+// (see "Reclaiming free pages" below). Large blocks are carved from the
+// region directly.
+#define BASE_REGION_SHIFT       30
+#define BASE_REGION_SIZE        (size_t(1) << BASE_REGION_SHIFT)
+#define BASE_ADDRESS_BITS       47
+#define BASE_COMMIT_SIZE        (1 << 20)
+#define BASE_SLAB_SHIFT         16
+#define BASE_SLAB_SIZE          (size_t(1) << BASE_SLAB_SHIFT)
+#define BASE_PAGESIZE           4096
+
+struct base_slab {
+    enum { slab = 1, dirty = 2, reclaiming = 4, released = 8 };
+    std::atomic<unsigned char> flags;   // 0 unless this range is a slab
+    std::atomic<uint16_t> released_pages;   // pages given back, by bit
+    uint16_t idle_pages;                // pages free at the last pass
+};
+static_assert(BASE_SLAB_SIZE / BASE_PAGESIZE == 16, "base_slab assumes 16 pages");
+
+struct base_region {
+    uintptr_t data;                     // first carved address
+    std::atomic<uintptr_t> end;         // blocks lie in [data, end)
+    uintptr_t committed;                // [data, committed) is accessible
+    uintptr_t limit;                    // end of the reservation
+    std::atomic<uint64_t>* starts;      // chunk bitmap
+    base_slab* slabs;                   // by slab index
+    base_region* next;                  // all regions, newest first
+
+    uintptr_t base() const {
+        return reinterpret_cast<uintptr_t>(this);
+    }
+    // return the chunk bitmap word and bit for `addr`
+    std::atomic<uint64_t>& word(uintptr_t addr) {
+        return starts[(addr - base()) >> 10];
+    }
+    static uint64_t bit(uintptr_t addr) {
+        return uint64_t(1) << ((addr >> 4) % 64);
+    }
+    base_slab& slab(uintptr_t addr) {
+        return slabs[(addr - base()) >> BASE_SLAB_SHIFT];
+    }
+};
+
+static std::atomic<base_region*> base_regions[size_t(1) << (BASE_ADDRESS_BITS
+                                                            - BASE_REGION_SHIFT)];
+static std::mutex region_lock;
+static base_region* region_current;     // protected by `region_lock`
+static std::atomic<base_region*> region_list;
+static std::atomic<uintptr_t> region_min{UINTPTR_MAX};
+static std::atomic<uintptr_t> region_max{0};
+
+static inline base_region* base_region_of(uintptr_t addr) {
+    if (addr >> BASE_ADDRESS_BITS) {
+        return nullptr;
+    }
+    return base_regions[addr >> BASE_REGION_SHIFT].load(std::memory_order_acquire);
+}
+
+// base_region_create(len)
+//    Reserve a region with room for a block of `len` bytes, or return
+//    nullptr. Called with `region_lock` held.
+static base_region* base_region_create(size_t len) {
+    if (len > (size_t(1) << (BASE_ADDRESS_BITS - 2))) {
+        return nullptr;
+    }
+    size_t size = BASE_REGION_SIZE;
+    while (size / 2 < len + size / 128) {
+        size *= 2;
+    }
+    size_t nslabs = size >> BASE_SLAB_SHIFT;
+    // the header takes whole slabs, so the first slab starts the heap
+    size_t hdrsize = (sizeof(base_region) + size / 128 + nslabs * sizeof(base_slab)
+                      + BASE_SLAB_SIZE - 1) & ~size_t(BASE_SLAB_SIZE - 1);
+    // reserve twice the size to find an aligned range, then trim
+    void* p = mmap(nullptr, 2 * size, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        return nullptr;
     }
-    ++disabled;
+    uintptr_t raw = reinterpret_cast<uintptr_t>(p);
+    uintptr_t base = (raw + size - 1) & ~uintptr_t(size - 1);
+    if (base != raw) {
+        munmap(p, base - raw);
+    }
+    munmap(reinterpret_cast<void*>(base + size), raw + size - base);
+    if (mprotect(reinterpret_cast<void*>(base), hdrsize, PROT_READ | PROT_WRITE) != 0) {
+        munmap(reinterpret_cast<void*>(base), size);
+        return nullptr;
+    }
+    base_region* r = new (reinterpret_cast<void*>(base)) base_region;
+    r->data = r->committed = base + hdrsize;
+    r->end.store(r->data, std::memory_order_relaxed);
+    r->limit = base + size;
+    // fresh memory is zero, which is the initial state of both arrays
+    r->starts = reinterpret_cast<std::atomic<uint64_t>*>(r + 1);
+    r->slabs = reinterpret_cast<base_slab*>(r->starts + size / 1024);
+    r->next = region_list.load(std::memory_order_relaxed);
+    region_list.store(r, std::memory_order_release);
+    for (uintptr_t a = base; a != base + size; a += BASE_REGION_SIZE) {
+        base_regions[a >> BASE_REGION_SHIFT].store(r, std::memory_order_release);
+    }
+    if (r->data < region_min.load(std::memory_order_relaxed)) {
+        region_min.store(r->data, std::memory_order_relaxed);
+    }
+    return r;
+}
+
+// base_region_commit(r, end)
+//    Make `r` accessible up to at least `end`. Called with `region_lock`
+//    held.
+static bool base_region_commit(base_region* r, uintptr_t end) {
+    if (end > r->committed) {
+        uintptr_t c = std::min((end + BASE_COMMIT_SIZE - 1)
+                               & ~uintptr_t(BASE_COMMIT_SIZE - 1), r->limit);
+        if (mprotect(reinterpret_cast<void*>(r->committed), c - r->committed,
+                     PROT_READ | PROT_WRITE) != 0) {
+            return false;
+        }
+        r->committed = c;
+    }
+    return true;
+}
+
+// base_carve(len, align)
+//    Return `len` bytes of fresh, zero memory aligned to `align`, or 0.
+static uintptr_t base_carve(size_t len, size_t align) {
+    std::lock_guard<std::mutex> guard(region_lock);
+    base_region* r = region_current;
+    uintptr_t p = 0;
+    if (r) {
+        p = (r->end.load(std::memory_order_relaxed) + align - 1) & ~uintptr_t(align - 1);
+    }
+    if (!r || p > r->limit || len > r->limit - p) {
+        // start a new region; the rest of the current one goes unused
+        if (!(r = base_region_create(len + align))) {
+            return 0;
+        }
+        region_current = r;
+        p = (r->data + align - 1) & ~uintptr_t(align - 1);
+    }
+    if (!base_region_commit(r, p + len)) {
+        return 0;
+    }
+    r->end.store(p + len, std::memory_order_release);
+    if (p + len > region_max.load(std::memory_order_relaxed)) {
+        region_max.store(p + len, std::memory_order_relaxed);
+    }
+    return p;
+}
+
+// base_extend(addr, len)
+//    Carve `len` bytes starting at `addr` if `addr` is the end of the
+//    current region's carved memory. Return true on success.
+static bool base_extend(uintptr_t addr, size_t len) {
+    std::lock_guard<std::mutex> guard(region_lock);
+    base_region* r = region_current;
+    if (!r || r->end.load(std::memory_order_relaxed) != addr
+        || len > r->limit - addr
+        || !base_region_commit(r, addr + len)) {
+        return false;
+    }
+    r->end.store(addr + len, std::memory_order_release);
+    if (addr + len > region_max.load(std::memory_order_relaxed)) {
+        region_max.store(addr + len, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Blocks from the system allocator, while the base allocator is
+// disabled, lie in [system_min, system_max).
+static std::atomic<uintptr_t> system_min{UINTPTR_MAX};
+static std::atomic<uintptr_t> system_max{0};
+
+static void base_note_system(uintptr_t addr, size_t sz) {
+    uintptr_t x = system_min.load(std::memory_order_relaxed);
+    while (addr < x && !system_min.compare_exchange_weak(x, addr)) {
+    }
+    x = system_max.load(std::memory_order_relaxed);
+    while (addr + sz > x && !system_max.compare_exchange_weak(x, addr + sz)) {
+    }
+}
+
+// base_mark(addr, active)
+//    Set or clear the chunk bitmap bit for the block at `addr`. Setting is
+//    sequentially consistent: with the slab flags load in base_slab_touch
+//    and the reclaimer's flag update and bitmap loads, it forms a Dekker
+//    handshake, so at least one side sees the other's write.
+static inline void base_mark(uintptr_t addr, bool active) {
+    if (base_region* r = base_region_of(addr)) {
+        if (active) {
+            r->word(addr).fetch_or(base_region::bit(addr), std::memory_order_seq_cst);
+        } else {
+            r->word(addr).fetch_and(~base_region::bit(addr), std::memory_order_release);
+        }
+    }
+}
+
+
+// Reclaiming free pages
+//    Freed small blocks wait in the size class FIFOs, so without help the
+//    pages of a load spike would stay resident forever. A reclamation
+//    pass finds slab pages that hold no part of an active block, using
+//    the chunk bitmap and each active block's size, and gives them back
+//    to the kernel with MADV_DONTNEED; they read as zero when used again.
+//    A freeing thread runs a pass once it has made `BASE_RECLAIM_INTERVAL`
+//    frees, if at least `BASE_RECLAIM_MIN_DIRTY` slabs have seen a free
+//    since they were last scanned. So that a page emptied and refilled in
+//    quick succession is not released every time, a pass releases only
+//    pages that were already free at the previous pass. base_trim
+//    releases every free page at once.
+//
+//    A slab is flagged `reclaiming` while it is scanned. A thread that
+//    allocates in a slab marks the block in the chunk bitmap and then waits
+//    while the slab is flagged, so a page is never released under a block
+//    in use.
+
+#define BASE_RECLAIM_INTERVAL   (1 << 14)
+#define BASE_RECLAIM_MIN_DIRTY  16
+
+static std::mutex reclaim_lock;
+static std::atomic<size_t> dirty_slabs;
+static std::atomic<unsigned long long> slab_size;       // # bytes in slabs
+static std::atomic<unsigned long long> reclaimed_size;  // # of those released
+
+// return the mask of slab pages overlapping [addr, addr + sz)
+static inline uint16_t base_slab_pages(uintptr_t addr, size_t sz) {
+    unsigned first = (addr % BASE_SLAB_SIZE) / BASE_PAGESIZE;
+    unsigned last = std::min((addr % BASE_SLAB_SIZE + sz - 1) / BASE_PAGESIZE,
+                             BASE_SLAB_SIZE / BASE_PAGESIZE - 1);
+    return (2U << last) - (1U << first);
+}
+
+// base_slab_touch(addr, sz)
+//    Prepare the newly marked block of `sz` bytes at `addr` for use.
+static inline void base_slab_touch(uintptr_t addr, size_t sz) {
+    base_slab& sl = base_region_of(addr)->slab(addr);
+    unsigned char f = sl.flags.load(std::memory_order_seq_cst);
+    while (f & base_slab::reclaiming) {
+        f = sl.flags.load(std::memory_order_acquire);
+    }
+    if (f & base_slab::released) {
+        uint16_t mask = base_slab_pages(addr, sz);
+        if (uint16_t was = sl.released_pages.fetch_and(~mask) & mask) {
+            reclaimed_size -= __builtin_popcount(was) * BASE_PAGESIZE;
+        }
+    }
+}
+
+// base_slab_dirty(addr)
+//    Note that a block in `addr`'s slab was freed.
+static inline void base_slab_dirty(uintptr_t addr) {
+    base_slab& sl = base_region_of(addr)->slab(addr);
+    unsigned char f = sl.flags.load(std::memory_order_relaxed);
+    if ((f & (base_slab::slab | base_slab::dirty)) == base_slab::slab
+        && !(sl.flags.fetch_or(base_slab::dirty) & base_slab::dirty)) {
+        ++dirty_slabs;
+    }
+}
+
+// base_reclaim_slab(r, sl, aged)
+//    Release the free pages of slab `sl` in region `r` and return the
+//    number of bytes released. If `aged` is true, a page is released
+//    only if it was also free at the previous scan.
+static size_t base_reclaim_slab(base_region* r, base_slab& sl, bool aged) {
+    unsigned char f = sl.flags.load(std::memory_order_relaxed);
+    while (!sl.flags.compare_exchange_weak(f, (f | base_slab::reclaiming)
+                                           & ~base_slab::dirty)) {
+    }
+    if (f & base_slab::dirty) {
+        --dirty_slabs;
+    }
+    uintptr_t start = r->base() + ((&sl - r->slabs) << BASE_SLAB_SHIFT);
+
+    // a page is busy if any active block overlaps it
+    uint16_t busy = 0;
+    for (uintptr_t w = start; w != start + BASE_SLAB_SIZE; w += 1024) {
+        uint64_t bits = r->word(w).load(std::memory_order_seq_cst);
+        for (; bits; bits &= bits - 1) {
+            uintptr_t addr = w + 16 * __builtin_ctzll(bits);
+            size_t sz;
+            if (base_lookup(reinterpret_cast<void*>(addr), &sz)) {
+                size_t csz = (base_class_size(base_size_class(sz)) + 15) & ~size_t(15);
+                busy |= base_slab_pages(addr, csz);
+            }
+        }
+    }
+    uint16_t empty = ~busy & ~sl.released_pages.load(std::memory_order_relaxed);
+    uint16_t release = aged ? empty & sl.idle_pages : empty;
+    sl.idle_pages = empty & ~release;
+
+    // release runs of adjacent pages with one call each
+    for (unsigned p = 0; p != 16; ) {
+        if (release & (1U << p)) {
+            unsigned q = p + 1;
+            while (q != 16 && (release & (1U << q))) {
+                ++q;
+            }
+            madvise(reinterpret_cast<void*>(start + p * BASE_PAGESIZE),
+                    (q - p) * BASE_PAGESIZE, MADV_DONTNEED);
+            p = q;
+        } else {
+            ++p;
+        }
+    }
+    if (release) {
+        sl.released_pages.fetch_or(release);
+        reclaimed_size += __builtin_popcount(release) * BASE_PAGESIZE;
+        sl.flags.fetch_or(base_slab::released);
+    }
+    sl.flags.fetch_and(~base_slab::reclaiming, std::memory_order_release);
+    if (sl.idle_pages) {
+        // scan again next pass
+        base_slab_dirty(start);
+    }
+    return __builtin_popcount(release) * BASE_PAGESIZE;
+}
+
+// base_reclaim(aged)
+//    Run a reclamation pass over the slabs freed into since their last
+//    scan, or over every slab if `aged` is false. Called with
+//    `reclaim_lock` held.
+static size_t base_reclaim(bool aged) {
+    size_t n = 0;
+    for (base_region* r = region_list.load(std::memory_order_acquire);
+         r; r = r->next) {
+        size_t nslabs = (r->end.load(std::memory_order_acquire) - r->base()
+                         + BASE_SLAB_SIZE - 1) >> BASE_SLAB_SHIFT;
+        for (size_t i = 0; i != nslabs; ++i) {
+            unsigned char f = r->slabs[i].flags.load(std::memory_order_acquire);
+            if ((f & base_slab::slab) && (!aged || (f & base_slab::dirty))) {
+                n += base_reclaim_slab(r, r->slabs[i], aged);
+            }
+        }
+    }
+    return n;
+}
+
+static void base_maybe_reclaim() {
+    if (dirty_slabs.load(std::memory_order_relaxed) >= BASE_RECLAIM_MIN_DIRTY
+        && reclaim_lock.try_lock()) {
+        base_reclaim(true);
+        reclaim_lock.unlock();
+    }
+}
+
+
+// Large blocks (more than `BASE_LARGE_THRESHOLD` bytes) bypass the size
+// class caches and are carved directly from the heap, rounded up to whole
+// pages of their class size. A freed large block first waits, still
+// resident and untouched, in a FIFO quarantine of `BASE_LARGE_QUARANTINE`
+// blocks. When it leaves quarantine its pages go back to the kernel with
+// MADV_DONTNEED and the empty range is kept for reuse by the same class.
+// Up to `BASE_LARGE_RETAIN` bytes of such ranges stay accessible; beyond
+// that they are decommitted, and made accessible again on reuse.
+#define BASE_LARGE_THRESHOLD    (8 << 10)
+#define BASE_LARGE_QUARANTINE   16
+#define BASE_LARGE_RETAIN       (64 << 20)
+
+struct base_large_state {
+    std::mutex lock;
+    struct entry {
+        uintptr_t addr;
+        int c;
+    };
+    entry quarantine[BASE_LARGE_QUARANTINE];
+    size_t qhead = 0;
+    size_t qsize = 0;
+    base_fifo released[BASE_NCLASSES];  // accessible, with no resident pages
+    base_fifo decommitted[BASE_NCLASSES];   // inaccessible
+    size_t retained = 0;                // # bytes in `released`
+    std::atomic<unsigned long long> mapped_size{0};
+    std::atomic<unsigned long long> resident_size{0};
+};
+
+static base_alloc_shard alloc_shards[BASE_NSHARDS];
+static base_large_state large;
+static base_depot_class depot[BASE_NCLASSES];
+static std::atomic<base_cache*> caches;
+static std::atomic<bool> disabled;
+
+static inline base_alloc_shard& base_shard(uintptr_t addr) {
+    return alloc_shards[(addr >> 4) % BASE_NSHARDS];
+}
+
+// add to a counter written only by this thread (no locked instruction)
+static inline void base_add(std::atomic<unsigned long long>& x,
+                            unsigned long long delta) {
+    x.store(x.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+static inline void base_count(std::atomic<unsigned long long>& x) {
+    base_add(x, 1);
+}
+
+// base_cache_sync(bc, c, osize)
+//    Update `bc`'s free byte count and nonempty-class bitmap after
+//    `bc->frees[c]` changed size from `osize`.
+static inline void base_cache_sync(base_cache* bc, int c, size_t osize) {
+    size_t nsize = bc->frees[c].size;
+    base_add(bc->free_size, (nsize - osize) * base_class_size(c));
+    if ((osize == 0) != (nsize == 0)) {
+        std::atomic<uint64_t>& w = bc->nonempty[c / 64];
+        w.store(w.load(std::memory_order_relaxed) ^ (uint64_t(1) << (c % 64)),
+                std::memory_order_relaxed);
+    }
+}
+
+static void base_depot_put(int c, base_fifo& from, size_t n) {
+    base_depot_class& d = depot[c];
+    std::lock_guard<std::mutex> guard(d.lock);
+    for (; n != 0 && d.frees.push(from.front()); --n) {
+        from.pop();
+    }
+    d.size.store(d.frees.size, std::memory_order_relaxed);
+}
+
+static void base_depot_get(int c, base_fifo& to, size_t n) {
+    base_depot_class& d = depot[c];
+    std::lock_guard<std::mutex> guard(d.lock);
+    for (; n != 0 && d.frees.size != 0 && to.push(d.frees.front()); --n) {
+        d.frees.pop();
+    }
+    d.size.store(d.frees.size, std::memory_order_relaxed);
+}
+
+
+// base_cache_owner: releases this thread's cache when the thread exits.
+struct base_cache_owner {
+    ~base_cache_owner();
+};
+
+static thread_local base_cache* local_cache;
+static thread_local bool local_cache_released;
+static thread_local base_cache_owner local_cache_owner;
+
+static base_cache* base_local_cache() {
+    if (local_cache) {
+        return local_cache;
+    } else if (local_cache_released) {
+        return nullptr;
+    }
+    (void) &local_cache_owner;  // register the thread-exit hook
+    // claim a cache left behind by an exited thread, or make a new one
+    base_cache* bc = caches.load(std::memory_order_acquire);
+    for (; bc; bc = bc->next) {
+        bool expected = false;
+        if (!bc->owned.load(std::memory_order_relaxed)
+            && bc->owned.compare_exchange_strong(expected, true)) {
+            break;
+        }
+    }
+    if (!bc) {
+        bc = new base_cache;
+        bc->next = caches.load(std::memory_order_relaxed);
+        while (!caches.compare_exchange_weak(bc->next, bc)) {
+        }
+    }
+    local_cache = bc;
+    return bc;
+}
+
+static inline size_t base_large_size(int c) {
+    return (base_class_size(c) + BASE_PAGESIZE - 1) & ~size_t(BASE_PAGESIZE - 1);
+}
+
+static uintptr_t base_large_malloc(int c, base_cache* bc) {
+    size_t len = base_large_size(c);
     uintptr_t ptr = 0;
+    bool newly_mapped = false;         // range was not accessible
+    {
+        std::lock_guard<std::mutex> guard(large.lock);
+        if (large.released[c].size) {
+            ptr = large.released[c].pop();
+            large.retained -= len;
+        } else if (large.decommitted[c].size) {
+            ptr = large.decommitted[c].pop();
+            newly_mapped = true;
+        }
+    }
+    if (newly_mapped
+        && mprotect(reinterpret_cast<void*>(ptr), len, PROT_READ | PROT_WRITE) != 0) {
+        std::lock_guard<std::mutex> guard(large.lock);
+        large.decommitted[c].push(ptr);
+        return 0;
+    }
+    if (ptr) {
+        if (bc) {
+            base_count(bc->nreuse);
+        }
+    } else {
+        ptr = base_carve(len, BASE_PAGESIZE);
+        if (!ptr) {
+            return 0;
+        }
+        newly_mapped = true;
+        if (bc) {
+            base_count(bc->nfresh);
+        }
+    }
+    if (newly_mapped) {
+        large.mapped_size += len;
+    }
+    large.resident_size += len;
+    return ptr;
+}
 
-    static int base_alloc_atexit_installed = 0;
-    if (!base_alloc_atexit_installed) {
-        atexit(base_allocator_atexit);
-        base_alloc_atexit_installed = 1;
-    }
-
-    // try to use a previously-freed block 75% of the time
-    unsigned r = alloc_random();
-    if (r % 4 != 0) {
-        for (unsigned ntries = 0; ntries < 10 && ntries < frees.size(); ++ntries) {
-            auto& f = frees[alloc_random() % frees.size()];
-            if (f.second >= sz) {
-                allocs.insert(f);
-                ptr = f.first;
-                f = frees.back();
-                frees.pop_back();
-                break;
+static void base_large_free(uintptr_t addr, int c) {
+    std::lock_guard<std::mutex> guard(large.lock);
+    if (large.qsize == BASE_LARGE_QUARANTINE) {
+        base_large_state::entry e = large.quarantine[large.qhead];
+        large.qhead = (large.qhead + 1) % BASE_LARGE_QUARANTINE;
+        --large.qsize;
+        size_t len = base_large_size(e.c);
+        void* p = reinterpret_cast<void*>(e.addr);
+        large.resident_size -= len;
+        // replacing the pages drops them and their commit charge; if that
+        // fails, the range is kept accessible instead
+        if (large.retained + len > BASE_LARGE_RETAIN
+            && mmap(p, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE
+                    | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            large.decommitted[e.c].push(e.addr);
+            large.mapped_size -= len;
+        } else {
+            madvise(p, len, MADV_DONTNEED);
+            if (large.released[e.c].push(e.addr)) {
+                large.retained += len;
             }
         }
     }
+    large.quarantine[(large.qhead + large.qsize) % BASE_LARGE_QUARANTINE] = {addr, c};
+    ++large.qsize;
+}
 
-    if (!ptr) {
-        // need a new allocation
-        ptr = reinterpret_cast<uintptr_t>(malloc(sz ? sz : 1));
+
+base_cache_owner::~base_cache_owner() {
+    if (base_cache* bc = local_cache) {
+        for (int c = 0; c != BASE_NCLASSES; ++c) {
+            if (size_t osize = bc->frees[c].size) {
+                base_depot_put(c, bc->frees[c], osize);
+                base_cache_sync(bc, c, osize);
+            }
+        }
+        local_cache = nullptr;
+        bc->owned.store(false, std::memory_order_release);
+    }
+    local_cache_released = true;
+}
+
+
+// base_carve_small(bc, csz, align)
+//    Carve a fresh small block of `csz` bytes from `bc`'s slab, taking a
+//    new slab when it runs out. Without a cache (the thread is exiting),
+//    carve straight from the region.
+static uintptr_t base_carve_small(base_cache* bc, size_t csz, size_t align) {
+    csz = (csz + 15) & ~size_t(15);
+    if (!bc) {
+        return base_carve(csz, align);
+    }
+    uintptr_t p = (bc->slab_next + align - 1) & ~uintptr_t(align - 1);
+    if (!bc->slab_next || p > bc->slab_end || csz > bc->slab_end - p) {
+        uintptr_t slab = base_carve(BASE_SLAB_SIZE, BASE_SLAB_SIZE);
+        if (!slab) {
+            return 0;
+        }
+        base_region_of(slab)->slab(slab).flags.store(base_slab::slab,
+                                                     std::memory_order_release);
+        slab_size += BASE_SLAB_SIZE;
+        bc->slab_next = slab;
+        bc->slab_end = slab + BASE_SLAB_SIZE;
+        p = (slab + align - 1) & ~uintptr_t(align - 1);
+    }
+    bc->slab_next = p + csz;
+    return p;
+}
+
+
+// base_allocate(sz, zero, align)
+//    Allocate `sz` bytes aligned to `align`, a power of 2 no larger than
+//    `BASE_PAGESIZE`, cleared to zero if `zero` is true. Large blocks are
+//    always zero already: they are either fresh or were released with
+//    MADV_DONTNEED or decommitted. Fresh small blocks are freshly carved,
+//    so also zero. Large blocks are page-aligned; a small block with
+//    `align > 16` reuses the oldest freed block in its class only if that
+//    block happens to be aligned.
+
+static void* base_allocate(size_t sz, bool zero, size_t align = 16) {
+    if (disabled.load(std::memory_order_relaxed)) {
+        void* p = nullptr;
+        if (align <= 16) {
+            p = zero ? calloc(1, sz) : malloc(sz);
+        } else if (posix_memalign(&p, align, sz) == 0 && zero) {
+            memset(p, 0, sz);
+        }
+        if (p) {
+            base_note_system(reinterpret_cast<uintptr_t>(p), sz);
+        }
+        return p;
+    }
+    // larger than the largest size class: cannot be satisfied
+    if (sz > base_class_size(BASE_NCLASSES - 1) || align > BASE_PAGESIZE) {
+        return nullptr;
+    }
+    uintptr_t ptr = 0;
+
+    int c = base_size_class(sz);
+    base_cache* bc = base_local_cache();
+    size_t granted;
+    if (sz > BASE_LARGE_THRESHOLD) {
+        ptr = base_large_malloc(c, bc);
+        granted = base_large_size(c);
+    } else {
+        granted = base_class_size(c);
+        // reuse the oldest freed block in this size class, if it has aged enough
+        if (bc
+            && bc->frees[c].size <= BASE_REUSE_DELAY
+            && depot[c].size.load(std::memory_order_relaxed) != 0) {
+            size_t osize = bc->frees[c].size;
+            base_depot_get(c, bc->frees[c], BASE_CACHE_LIMIT / 2);
+            base_cache_sync(bc, c, osize);
+        }
+        if (bc && bc->frees[c].size > BASE_REUSE_DELAY
+            && (bc->frees[c].front() & (align - 1)) == 0) {
+            ptr = bc->frees[c].pop();
+            base_cache_sync(bc, c, bc->frees[c].size + 1);
+            base_count(bc->nreuse);
+            if (zero) {
+                memset(reinterpret_cast<void*>(ptr), 0, sz);
+            }
+        } else {
+            // need a new allocation
+            ptr = base_carve_small(bc, base_class_size(c), align);
+            if (ptr && bc) {
+                base_count(bc->nfresh);
+            }
+        }
+    }
+    if (ptr && bc) {
+        base_add(bc->granted_size, granted);
     }
     if (ptr) {
-        allocs[reinterpret_cast<uintptr_t>(ptr)] = sz;
+        {
+            base_alloc_shard& shard = base_shard(ptr);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            shard.allocs.insert(ptr, sz);
+            base_mark(ptr, true);
+        }
+        if (sz <= BASE_LARGE_THRESHOLD) {
+            base_slab_touch(ptr, granted);
+        }
     }
 
-    --disabled;
     return reinterpret_cast<void*>(ptr);
 }
 
-void base_free(void* ptr) {
-    if (disabled || !ptr) {
+void* base_malloc(size_t sz) {
+    return base_allocate(sz, false);
+}
+
+void* base_calloc(size_t sz) {
+    return base_allocate(sz, true);
+}
+
+void* base_aligned_malloc(size_t align, size_t sz) {
+    return base_allocate(sz, false, align);
+}
+
+
+// base_lookup(ptr, sz)
+//    Return true if `ptr` is an active block, and set `*sz` to its size.
+
+bool base_lookup(void* ptr, size_t* sz) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    base_alloc_shard& shard = base_shard(addr);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    base_table::slot* s = shard.allocs.lookup(addr);
+    if (s) {
+        *sz = s->size;
+    }
+    return s != nullptr;
+}
+
+
+// base_classify(ptr)
+//    Return whether `ptr` is outside the heap, the start of an active
+//    block, or elsewhere in the heap (inside a block, or a freed or
+//    unused address). Blocks allocated while the base allocator was
+//    disabled are never block starts.
+
+base_heap_class base_classify(void* ptr) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    if (base_region* r = base_region_of(addr)) {
+        if (addr < r->data || addr >= r->end.load(std::memory_order_acquire)) {
+            return base_not_in_heap;
+        } else if (addr % 16 == 0
+                   && (r->word(addr).load(std::memory_order_acquire)
+                       & base_region::bit(addr))) {
+            return base_block_start;
+        } else {
+            return base_in_heap;
+        }
+    } else if (addr >= system_min.load(std::memory_order_relaxed)
+               && addr < system_max.load(std::memory_order_relaxed)) {
+        return base_in_heap;
+    } else {
+        return base_not_in_heap;
+    }
+}
+
+
+// base_resize(ptr, sz, oldsz)
+//    Change the size of `ptr` to `sz` without moving it, if possible, and
+//    return true on success. `*oldsz` is set to the size `ptr` had, or 0
+//    if it is not an active block. A small block can use the slack of its
+//    size class. A large block can change class within its pages, and can
+//    grow if it is the most recently carved block.
+
+bool base_resize(void* ptr, size_t sz, size_t* oldsz) {
+    *oldsz = 0;
+    if (disabled.load(std::memory_order_relaxed) || !ptr) {
+        return false;
+    }
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    base_alloc_shard& shard = base_shard(addr);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    base_table::slot* s = shard.allocs.lookup(addr);
+    if (!s) {
+        return false;
+    }
+    *oldsz = s->size;
+    int oc = base_size_class(s->size);
+    if (sz > base_class_size(BASE_NCLASSES - 1)
+        || (sz > BASE_LARGE_THRESHOLD) != (s->size > BASE_LARGE_THRESHOLD)) {
+        return false;
+    }
+    int c = base_size_class(sz);
+    if (sz > BASE_LARGE_THRESHOLD && c != oc) {
+        size_t olen = base_large_size(oc), len = base_large_size(c);
+        if (len < olen
+            || (len > olen && !base_extend(addr + olen, len - olen))) {
+            // a shrunken block's spare pages could never be reused
+            return false;
+        }
+        large.mapped_size += len - olen;
+        large.resident_size += len - olen;
+        if (base_cache* bc = base_local_cache()) {
+            base_add(bc->granted_size, len - olen);
+        }
+    } else if (c != oc) {
+        return false;
+    }
+    s->size = sz;
+    return true;
+}
+
+// base_release(ptr, caller)
+//    Free `ptr` and return the size it was allocated with, or 0 if the
+//    base allocator is disabled or `ptr` was not allocated. `caller` is
+//    reported for invalid frees.
+
+static size_t base_release(void* ptr, void* caller) {
+    if (disabled.load(std::memory_order_relaxed) || !ptr) {
         free(ptr);
+        return 0;
+    }
+
+    // mark free if found; if not found, complain about invalid free
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    base_alloc_shard& shard = base_shard(addr);
+    size_t sz;
+    {
+        base_table::slot* s = nullptr;
+        std::unique_lock<std::mutex> guard(shard.lock, std::defer_lock);
+        if (base_classify(ptr) == base_block_start) {
+            guard.lock();
+            s = shard.allocs.lookup(addr);
+        }
+        if (!s) {
+            fprintf(stderr, "ERROR: invalid free of %p at %p", ptr, caller);
+            return 0;
+        }
+        sz = s->size;
+        base_mark(addr, false);
+        shard.allocs.erase(s);
+    }
+
+    int c = base_size_class(sz);
+    base_cache* bc = base_local_cache();
+    if (bc) {
+        base_add(bc->granted_size, -(unsigned long long)
+                 (sz > BASE_LARGE_THRESHOLD ? base_large_size(c) : base_class_size(c)));
+    }
+    if (sz > BASE_LARGE_THRESHOLD) {
+        base_large_free(addr, c);
+        return sz;
+    }
+    base_slab_dirty(addr);
+    if (bc) {
+        size_t osize = bc->frees[c].size;
+        bc->frees[c].push(addr);
+        if (bc->frees[c].size > BASE_CACHE_LIMIT) {
+            base_depot_put(c, bc->frees[c], BASE_CACHE_LIMIT / 2);
+        }
+        base_cache_sync(bc, c, osize);
+        if (++bc->nfree_unchecked == BASE_RECLAIM_INTERVAL) {
+            bc->nfree_unchecked = 0;
+            base_maybe_reclaim();
+        }
     } else {
-        // mark free if found; if not found, complain about invalid free
-        ++disabled;
-        auto it = allocs.find(reinterpret_cast<uintptr_t>(ptr));
-        if (it != allocs.end()) {
-            frees.push_back(*it);
-            allocs.erase(it);
-        } else {
-            fprintf(stderr, "ERROR: invalid free of %p at %p", ptr,
-                    __builtin_extract_return_addr(__builtin_return_address(0)));
+        // thread is exiting; hand the block straight to the depot
+        base_fifo one;
+        if (one.push(addr)) {
+            base_depot_put(c, one, 1);
+            free(one.slots);
+        }
+    }
+    return sz;
+}
+
+void base_free(void* ptr) {
+    base_release(ptr, __builtin_extract_return_addr(__builtin_return_address(0)));
+}
+
+size_t base_free_size(void* ptr) {
+    return base_release(ptr, __builtin_extract_return_addr(__builtin_return_address(0)));
+}
+
+// base_trim()
+//    Release every free slab page now, and return the number of bytes
+//    released.
+
+size_t base_trim() {
+    std::lock_guard<std::mutex> guard(reclaim_lock);
+    return base_reclaim(false);
+}
+
+// base_fork_prepare(), base_fork_parent(), base_fork_child()
+//    Fork hooks, called by m61's pthread_atfork handlers. `prepare` takes
+//    every base allocator lock, in lock order, so no shared structure is
+//    mid-update at the fork. In the child, the other threads are gone, but
+//    their caches may have been mid-update, since caches are not locked.
+//    The child empties those caches, forgetting their free blocks and
+//    slabs, and releases them for reuse by new threads.
+
+void base_fork_prepare() {
+    reclaim_lock.lock();
+    for (auto& shard : alloc_shards) {
+        shard.lock.lock();
+    }
+    region_lock.lock();
+    large.lock.lock();
+    for (auto& d : depot) {
+        d.lock.lock();
+    }
+}
+
+void base_fork_parent() {
+    for (auto& d : depot) {
+        d.lock.unlock();
+    }
+    large.lock.unlock();
+    region_lock.unlock();
+    for (auto& shard : alloc_shards) {
+        shard.lock.unlock();
+    }
+    reclaim_lock.unlock();
+}
+
+void base_fork_child() {
+    for (base_cache* bc = caches.load(std::memory_order_relaxed);
+         bc; bc = bc->next) {
+        if (bc == local_cache || !bc->owned.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        // a fifo may have been mid-grow, so its array is abandoned too
+        for (auto& f : bc->frees) {
+            f = base_fifo();
+        }
+        for (auto& w : bc->nonempty) {
+            w.store(0, std::memory_order_relaxed);
         }
-        --disabled;
+        bc->free_size.store(0, std::memory_order_relaxed);
+        bc->slab_next = bc->slab_end = 0;
+        bc->nfree_unchecked = 0;
+        bc->owned.store(false, std::memory_order_relaxed);
     }
+    base_fork_parent();
 }
 
 void base_allocator_disable(bool d) {
-    disabled = d;
+    disabled.store(d, std::memory_order_relaxed);
 }
 
-static void base_allocator_atexit() {
-    // clean up freed memory to shut up leak detector
-    for (auto& alloc : frees) {
-        free(reinterpret_cast<void*>(alloc.first));
+void base_allocator_statistics(m61_statistics* stats) {
+    stats->nreuse = stats->nfresh = 0;
+    stats->granted_size = stats->free_size = 0;
+    uint64_t nonempty[(BASE_NCLASSES + 63) / 64] = {};
+    for (base_cache* bc = caches.load(std::memory_order_acquire);
+         bc; bc = bc->next) {
+        stats->nreuse += bc->nreuse.load(std::memory_order_relaxed);
+        stats->nfresh += bc->nfresh.load(std::memory_order_relaxed);
+        stats->granted_size += bc->granted_size.load(std::memory_order_relaxed);
+        stats->free_size += bc->free_size.load(std::memory_order_relaxed);
+        for (size_t i = 0; i != sizeof(nonempty) / sizeof(nonempty[0]); ++i) {
+            nonempty[i] |= bc->nonempty[i].load(std::memory_order_relaxed);
+        }
+    }
+    // held free blocks: caches plus depot; only small classes fragment,
+    // since large blocks give their memory back
+    stats->largest_free_block = 0;
+    for (int c = 0; c != BASE_NCLASSES; ++c) {
+        size_t n = depot[c].size.load(std::memory_order_relaxed);
+        stats->free_size += n * base_class_size(c);
+        if ((n != 0 || (nonempty[c / 64] & (uint64_t(1) << (c % 64))))
+            && c <= base_size_class(BASE_LARGE_THRESHOLD)) {
+            stats->largest_free_block = base_class_size(c);
+        }
+    }
+    // slabs count as resident, less the pages reclaimed from them
+    unsigned long long small_size = slab_size.load(std::memory_order_relaxed);
+    stats->virtual_size = small_size + large.mapped_size.load(std::memory_order_relaxed);
+    stats->resident_size = small_size - reclaimed_size.load(std::memory_order_relaxed)
+        + large.resident_size.load(std::memory_order_relaxed);
+    // the heap's bounds are those of the carved parts of its regions
+    stats->heap_min = std::min(region_min.load(std::memory_order_relaxed),
+                               system_min.load(std::memory_order_relaxed));
+    stats->heap_max = std::max(region_max.load(std::memory_order_relaxed),
+                               system_max.load(std::memory_order_relaxed));
+    if (stats->heap_min > stats->heap_max) {
+        stats->heap_min = stats->heap_max = 0;
     }
 }
@@ -4,7 +4,1605 @@
 #include <cstring>
 #include <cstdio>
 #include <cinttypes>
+#include <climits>
 #include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <chrono>
+#include <dlfcn.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// m61 is compiled with the checking features of `M61_POLICY`; see
+// m61_policy in m61.hh.
+#ifndef M61_POLICY
+#define M61_POLICY m61_debug_policy
+#endif
+using m61_config = M61_POLICY;
+
+// Blocks go in the side table if any feature needs to look them up.
+static constexpr bool m61_track_blocks = m61_config::wild_free
+    || m61_config::canaries || m61_config::leak_tracking
+    || m61_config::lifetimes || m61_config::quarantine;
+// Active blocks are also indexed by address (see `m61_radix`) for wild
+// pointer lookups and for reports that walk the live blocks.
+static constexpr bool m61_index_blocks = m61_config::wild_free
+    || m61_config::leak_tracking;
+
+
+// m61_block
+//    Metadata for one block. It lives in a side table rather than next to
+//    the block, so wild writes cannot corrupt it and a wild free cannot
+//    forge it. Freed blocks keep their entry, marked inactive, until the
+//    address is handed out again; that is how double frees are recognized.
+struct m61_block {
+    uintptr_t addr;                     // block address; 0 marks an empty slot
+    size_t size;                        // requested size
+    const char* file;                   // allocation site
+    long line;
+    uint64_t trace_id;                  // id in the allocation trace, if any
+    uint64_t generation;                // snapshot generation at allocation
+    uint64_t birth;                     // timestamp, if profiling lifetimes
+    bool active;                        // false once freed
+};
+
+
+// m61_stack_table
+//    Interned call stacks. An entry is an allocation site plus the return
+//    addresses above it, found by following frame pointers. Entries are
+//    never removed, so an entry's index is a permanent stack id. Lookup
+//    and insertion are lock-free: a thread claims an empty slot by moving
+//    its state from empty to writing, fills it in, then publishes it as
+//    ready. A lookup that meets a slot still being written gives up
+//    rather than wait for the writer, as does one that finds the table
+//    full; the allocation is then attributed to its immediate site.
+
+#define M61_STACK_MAXDEPTH  16
+#define M61_STACK_NSLOTS    (1 << 14)
+
+struct m61_stack {
+    enum { empty = 0, writing = 1, ready = 2 };
+    std::atomic<unsigned> state;
+    unsigned depth;
+    uint64_t hash;
+    const char* file;                   // innermost allocation site
+    long line;
+    uintptr_t frames[M61_STACK_MAXDEPTH];   // return addresses, innermost first
+};
+
+static m61_stack stack_table[M61_STACK_NSLOTS];
+static std::atomic<unsigned> stack_depth{0};
+static std::atomic<unsigned long> stack_rate{1};
+static thread_local unsigned long stack_countdown;
+static thread_local uintptr_t stack_lo, stack_hi;   // this thread's stack
+
+// m61_stack_intern(file, line, frames, depth)
+//    Return the id of the given stack, adding it if necessary, or -1 if
+//    the table is full or the probe meets a slot being written.
+static long m61_stack_intern(const char* file, long line,
+                             const uintptr_t* frames, unsigned depth) {
+    uint64_t h = reinterpret_cast<uintptr_t>(file) ^ (uint64_t(line) << 32);
+    for (unsigned i = 0; i != depth; ++i) {
+        h = (h ^ frames[i]) * 0x9E3779B97F4A7C15ULL;
+    }
+    h ^= h >> 29;
+    for (size_t n = 0, i = h; n != M61_STACK_NSLOTS; ++n, ++i) {
+        m61_stack& s = stack_table[i % M61_STACK_NSLOTS];
+        unsigned state = s.state.load(std::memory_order_acquire);
+        if (state == m61_stack::empty
+            && s.state.compare_exchange_strong(state, m61_stack::writing)) {
+            s.hash = h;
+            s.file = file;
+            s.line = line;
+            s.depth = depth;
+            memcpy(s.frames, frames, depth * sizeof(uintptr_t));
+            s.state.store(m61_stack::ready, std::memory_order_release);
+            return &s - stack_table;
+        }
+        if (state == m61_stack::writing) {
+            return -1;
+        }
+        if (s.hash == h && s.file == file && s.line == line && s.depth == depth
+            && memcmp(s.frames, frames, depth * sizeof(uintptr_t)) == 0) {
+            return &s - stack_table;
+        }
+    }
+    return -1;
+}
+
+static void m61_stack_init_bounds() {
+    pthread_attr_t attr;
+    void* addr;
+    size_t size;
+    stack_lo = stack_hi = 1;            // unknown: capture nothing
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+            stack_lo = reinterpret_cast<uintptr_t>(addr);
+            stack_hi = stack_lo + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+}
+
+// m61_stack_site(file, line, frame)
+//    If stack capture is on and samples this allocation, replace
+//    `file`:`line` with the interned stack above `frame`, the frame of the
+//    m61 function called by the allocating code. The walk stops after
+//    `stack_depth` frames or at the first frame pointer that does not
+//    point further up this thread's stack.
+static void m61_stack_site(const char*& file, long& line, void* frame);
+
+
+// Allocation sites
+//    A site is a `file`:`line` pair. Sites recorded by return address use
+//    `m61_retaddr_file` as their file and the address as their line.
+//    Sites with a captured call stack use `m61_stack_file` and the stack
+//    id. Both are symbolized only when a report prints them.
+
+const char m61_retaddr_file[] = "<retaddr>";
+static const char m61_stack_file[] = "<stack>";
+
+struct m61_site_name {
+    char s[1024];
+};
+
+// m61_symbolize(buf, size, addr)
+//    Print code address `addr` into `buf` as `object(symbol+offset)`.
+static int m61_symbolize(char* buf, size_t size, uintptr_t addr) {
+    Dl_info info;
+    if (!dladdr(reinterpret_cast<void*>(addr), &info) || !info.dli_fname) {
+        return snprintf(buf, size, "%#lx", addr);
+    } else if (info.dli_sname) {
+        return snprintf(buf, size, "%s(%s+%#lx)", info.dli_fname, info.dli_sname,
+                        addr - reinterpret_cast<uintptr_t>(info.dli_saddr));
+    } else {
+        return snprintf(buf, size, "%s(+%#lx)", info.dli_fname,
+                        addr - reinterpret_cast<uintptr_t>(info.dli_fbase));
+    }
+}
+
+static m61_site_name m61_site(const char* file, long line) {
+    m61_site_name n;
+    if (file == m61_retaddr_file) {
+        m61_symbolize(n.s, sizeof(n.s), line);
+    } else if (m61_config::stacks && file == m61_stack_file) {
+        // innermost site, then its callers
+        const m61_stack& s = stack_table[line];
+        size_t len = snprintf(n.s, sizeof(n.s), "%s", m61_site(s.file, s.line).s);
+        for (unsigned i = 1; i < s.depth && len < sizeof(n.s); ++i) {
+            len += snprintf(n.s + len, sizeof(n.s) - len, " <- ");
+            if (len < sizeof(n.s)) {
+                len += m61_symbolize(n.s + len, sizeof(n.s) - len, s.frames[i]);
+            }
+        }
+    } else {
+        snprintf(n.s, sizeof(n.s), "%s:%ld", file, line);
+    }
+    return n;
+}
+
+
+// m61_printer
+//    Signal-safe printing into a fixed buffer, like pset6's
+//    `simple_printer`, except that output past the end of the buffer is
+//    dropped rather than asserted against.
+struct m61_printer {
+    char* buf_;
+    char* s_;
+    char* end_;
+
+    m61_printer(char* buf, size_t sz)
+        : buf_(buf), s_(buf), end_(buf + sz) {
+    }
+
+    m61_printer& operator<<(char ch) {
+        if (s_ != end_) {
+            *s_ = ch;
+            ++s_;
+        }
+        return *this;
+    }
+    m61_printer& operator<<(const char* s) {
+        while (*s) {
+            *this << *s;
+            ++s;
+        }
+        return *this;
+    }
+    m61_printer& operator<<(unsigned long long i) {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = '0' + i % 10;
+            i /= 10;
+        } while (i != 0);
+        while (n != 0) {
+            *this << digits[--n];
+        }
+        return *this;
+    }
+    m61_printer& hex(uintptr_t x) {
+        *this << "0x";
+        int shift = 60;
+        while (shift > 0 && (x >> shift) == 0) {
+            shift -= 4;
+        }
+        for (; shift >= 0; shift -= 4) {
+            *this << "0123456789abcdef"[(x >> shift) & 15];
+        }
+        return *this;
+    }
+
+    // write the buffer to `fd` and empty it; may change `errno`
+    void flush(int fd) {
+        for (char* p = buf_; p < s_; ) {
+            ssize_t w = write(fd, p, s_ - p);
+            if (w > 0) {
+                p += w;
+            } else if (w == 0 || (errno != EINTR && errno != EAGAIN)) {
+                break;
+            }
+        }
+        s_ = buf_;
+    }
+};
+
+// m61_write_site(pr, file, line)
+//    Print a site like m61_site, but with code addresses unsymbolized,
+//    since dladdr is not signal-safe.
+static void m61_write_site(m61_printer& pr, const char* file, long line) {
+    if (file == m61_retaddr_file) {
+        pr.hex(line);
+    } else if (m61_config::stacks && file == m61_stack_file) {
+        const m61_stack& s = stack_table[line];
+        m61_write_site(pr, s.file, s.line);
+        for (unsigned i = 1; i < s.depth; ++i) {
+            pr << " <- ";
+            pr.hex(s.frames[i]);
+        }
+    } else {
+        pr << file << ':' << static_cast<unsigned long long>(line);
+    }
+}
+
+static void m61_stack_site(const char*& file, long& line, void* frame) {
+    unsigned depth = stack_depth.load(std::memory_order_relaxed);
+    if (!m61_config::stacks || depth == 0) {
+        return;
+    }
+    unsigned long rate = stack_rate.load(std::memory_order_relaxed);
+    if (stack_countdown == 0 || stack_countdown > rate) {
+        stack_countdown = rate;
+    }
+    if (--stack_countdown != 0) {
+        return;
+    }
+    if (!stack_hi) {
+        m61_stack_init_bounds();
+    }
+    uintptr_t frames[M61_STACK_MAXDEPTH];
+    unsigned n = 0;
+    uintptr_t fp = reinterpret_cast<uintptr_t>(frame);
+    while (n != depth && fp >= stack_lo && fp + 2 * sizeof(uintptr_t) <= stack_hi
+           && fp % sizeof(uintptr_t) == 0) {
+        // x86-64 frame: saved frame pointer, then return address
+        const uintptr_t* f = reinterpret_cast<const uintptr_t*>(fp);
+        if (f[1] == 0) {
+            break;
+        }
+        frames[n++] = f[1];
+        if (f[0] <= fp) {
+            break;
+        }
+        fp = f[0];
+    }
+    long id = m61_stack_intern(file, line, frames, n);
+    if (id >= 0) {
+        file = m61_stack_file;
+        line = id;
+    }
+}
+
+
+/// m61_set_stack_depth(depth, rate)
+///    Capture up to `depth` frames of call stack for one in every `rate`
+///    allocations, and attribute them by stack.
+
+void m61_set_stack_depth(unsigned depth, unsigned long rate) {
+    stack_depth.store(std::min(depth, unsigned(M61_STACK_MAXDEPTH)),
+                      std::memory_order_relaxed);
+    stack_rate.store(rate ? rate : 1, std::memory_order_relaxed);
+}
+
+
+// Snapshot generation
+//    Every block records the generation current when it was allocated.
+//    m61_snapshot starts a new generation, so the blocks allocated since a
+//    snapshot are exactly the live blocks with a generation at least its
+//    value. Allocation only reads the counter.
+static std::atomic<uint64_t> generation{1};
+
+
+// m61_radix
+//    Address-ordered index of active block addresses: a 64-way radix tree
+//    of bitmaps. Level-1 nodes hold leaf words with one bit per key; every
+//    node's `bits` records which of its slots are nonempty. Insert, erase
+//    and predecessor queries touch one node per level, so they cost
+//    O(M61_RADIX_LEVELS) regardless of how many blocks are live.
+
+#define M61_RADIX_LEVELS    7           // keys up to 6 * (7 + 1) = 48 bits
+#define M61_RADIX_MAXKEY    ((uint64_t(1) << (6 * (M61_RADIX_LEVELS + 1))) - 1)
+
+struct m61_radix_node {
+    uint64_t bits = 0;                  // bit i set iff slot i is nonempty
+    union {
+        m61_radix_node* child[64];      // levels >= 2
+        uint64_t leaf[64];              // level 1: one bit per key
+    };
+    m61_radix_node() {
+        memset(child, 0, sizeof(child));
+    }
+};
+
+struct m61_radix {
+    m61_radix_node* root = nullptr;
+
+    void insert(uint64_t key);
+    void erase(uint64_t key);
+    // find the largest key <= `key`; return false if there is none
+    bool predecessor(uint64_t key, uint64_t* result) const {
+        return root && max_below(root, M61_RADIX_LEVELS,
+                                 std::min(key, M61_RADIX_MAXKEY), result);
+    }
+    // call `f(key)` for every key, in increasing order
+    template <typename F>
+    void for_each(F f) const {
+        if (root) {
+            for_each(root, M61_RADIX_LEVELS, 0, f);
+        }
+    }
+
+  private:
+    static bool max_below(const m61_radix_node* n, int level, uint64_t key,
+                          uint64_t* result);
+    template <typename F>
+    static void for_each(const m61_radix_node* n, int level, uint64_t prefix,
+                         F& f) {
+        for (uint64_t bits = n->bits; bits; bits &= bits - 1) {
+            unsigned i = __builtin_ctzll(bits);
+            if (level == 1) {
+                for (uint64_t w = n->leaf[i]; w; w &= w - 1) {
+                    f((prefix << 12) | (i << 6) | __builtin_ctzll(w));
+                }
+            } else {
+                for_each(n->child[i], level - 1, (prefix << 6) | i, f);
+            }
+        }
+    }
+};
+
+void m61_radix::insert(uint64_t key) {
+    assert(key <= M61_RADIX_MAXKEY);
+    if (!root) {
+        root = new m61_radix_node;
+    }
+    m61_radix_node* n = root;
+    for (int level = M61_RADIX_LEVELS; level != 1; --level) {
+        unsigned i = (key >> (6 * level)) & 63;
+        if (!n->child[i]) {
+            n->child[i] = new m61_radix_node;
+        }
+        n->bits |= uint64_t(1) << i;
+        n = n->child[i];
+    }
+    unsigned i = (key >> 6) & 63;
+    n->leaf[i] |= uint64_t(1) << (key & 63);
+    n->bits |= uint64_t(1) << i;
+}
+
+void m61_radix::erase(uint64_t key) {
+    // nodes are kept for reuse; only the summary bits are cleared
+    m61_radix_node* path[M61_RADIX_LEVELS + 1];
+    m61_radix_node* n = root;
+    for (int level = M61_RADIX_LEVELS; level != 1; --level) {
+        path[level] = n;
+        n = n->child[(key >> (6 * level)) & 63];
+    }
+    unsigned i = (key >> 6) & 63;
+    n->leaf[i] &= ~(uint64_t(1) << (key & 63));
+    for (int level = 1; level <= M61_RADIX_LEVELS; ++level) {
+        bool empty = level == 1 ? n->leaf[i] == 0 : n->child[i]->bits == 0;
+        if (!empty) {
+            break;
+        }
+        n->bits &= ~(uint64_t(1) << i);
+        if (level != M61_RADIX_LEVELS) {
+            i = (key >> (6 * (level + 1))) & 63;
+            n = path[level + 1];
+        }
+    }
+}
+
+bool m61_radix::max_below(const m61_radix_node* n, int level, uint64_t key,
+                          uint64_t* result) {
+    unsigned i = (key >> (6 * level)) & 63;
+    if (level == 1) {
+        unsigned b = key & 63;
+        uint64_t w = n->leaf[i] & (b == 63 ? ~uint64_t(0) : (uint64_t(2) << b) - 1);
+        if (w) {
+            *result = (key & ~uint64_t(63)) | (63 - __builtin_clzll(w));
+            return true;
+        }
+    } else if (((n->bits >> i) & 1)
+               && max_below(n->child[i], level - 1, key, result)) {
+        return true;
+    }
+    // nothing at or below `key` in slot i: take the maximum of the
+    // nearest nonempty slot to its left, which must exist if any bit is set
+    uint64_t left = n->bits & ((uint64_t(1) << i) - 1);
+    if (!left) {
+        return false;
+    }
+    unsigned j = 63 - __builtin_clzll(left);
+    uint64_t span = uint64_t(1) << (6 * level);
+    key = (key & ~(64 * span - 1)) | (j * span) | (span - 1);
+    return max_below(n, level, key, result);
+}
+
+
+// m61_mutex
+//    A std::mutex that a signal handler can also claim, for the leak
+//    report. `pthread_mutex_trylock` is not async-signal-safe, so the
+//    handler instead claims `state` with one lock-free compare-and-swap,
+//    which is. A thread that takes the mutex also claims `state`, waiting
+//    out a report in progress; a handler that finds `state` claimed
+//    (possibly by the thread it interrupted) gives up instead of waiting.
+
+struct m61_mutex {
+    std::mutex m;
+    std::atomic<int> state{0};          // 0 free, 1 locked, 2 reporting
+
+    void lock() {
+        m.lock();
+        int expected = 0;
+        while (!state.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+            expected = 0;
+        }
+    }
+    void unlock() {
+        state.store(0, std::memory_order_release);
+        m.unlock();
+    }
+    // async-signal-safe; never waits
+    bool try_claim() {
+        int expected = 0;
+        return state.compare_exchange_strong(expected, 2, std::memory_order_acquire);
+    }
+    void release_claim() {
+        state.store(0, std::memory_order_release);
+    }
+};
+
+
+// m61_table_shard
+//    Side table of block metadata, split into `M61_NSHARDS` shards by block
+//    address. Each shard is an open-addressing hash table (linear probing,
+//    at most half full) plus the radix index of its active blocks, under
+//    one lock. Freeing or validating a pointer costs one O(1) probe; the
+//    table only allocates when it doubles.
+//
+//    Shard `s` holds blocks whose address bits 4-9 equal `s`, so within a
+//    shard, `addr >> 10` identifies a (16-byte-aligned) block uniquely and
+//    keeps the radix tree dense.
+
+#define M61_NSHARDS         64
+
+struct m61_table_shard {
+    m61_mutex lock;
+    m61_block* slots = nullptr;
+    size_t capacity = 0;                // 0 or a power of 2
+    size_t n = 0;
+    m61_radix starts;                   // keys of active blocks
+
+    // return the slot holding `addr`, or the empty slot where it belongs
+    m61_block* find(uintptr_t addr) {
+        size_t i = (addr * 0x9E3779B97F4A7C15ULL) >> 32;
+        while (true) {
+            i &= capacity - 1;
+            if (slots[i].addr == addr || slots[i].addr == 0) {
+                return &slots[i];
+            }
+            ++i;
+        }
+    }
+    m61_block* lookup(uintptr_t addr) {
+        if (capacity == 0) {
+            return nullptr;
+        }
+        m61_block* b = find(addr);
+        return b->addr ? b : nullptr;
+    }
+    m61_block* insert(uintptr_t addr) {
+        if (2 * (n + 1) > capacity) {
+            grow();
+        }
+        m61_block* b = find(addr);
+        if (!b->addr) {
+            b->addr = addr;
+            ++n;
+        }
+        return b;
+    }
+    void grow();
+} __attribute__((aligned(64)));
+
+static m61_table_shard block_table[M61_NSHARDS];
+
+void m61_table_shard::grow() {
+    m61_block* oslots = slots;
+    size_t ocapacity = capacity;
+    capacity = capacity ? capacity * 2 : 256;
+    slots = new m61_block[capacity];
+    memset(slots, 0, sizeof(m61_block) * capacity);
+    for (size_t i = 0; i != ocapacity; ++i) {
+        if (oslots[i].addr) {
+            *find(oslots[i].addr) = oslots[i];
+        }
+    }
+    delete[] oslots;
+}
+
+static inline m61_table_shard& m61_shard(uintptr_t addr) {
+    return block_table[(addr >> 4) % M61_NSHARDS];
+}
+
+static inline uint64_t m61_radix_key(uintptr_t addr) {
+    assert((addr & 15) == 0);
+    return addr >> 10;
+}
+
+// m61_for_each_active(ts, f)
+//    Call `f(b)` for each active block in shard `ts`, in address order.
+//    Freed entries stay in the hash table until their address is reused,
+//    so this walks the radix index instead: the cost grows with the live
+//    blocks only. Does nothing if blocks are not indexed. The caller holds
+//    `ts.lock`.
+template <typename F>
+static void m61_for_each_active(m61_table_shard& ts, F f) {
+    if constexpr (m61_index_blocks) {
+        uintptr_t s = &ts - block_table;
+        ts.starts.for_each([&] (uint64_t k) {
+            const m61_block* b = ts.lookup((k << 10) | (s << 4));
+            assert(b && b->active);
+            f(*b);
+        });
+    }
+}
+
+// m61_find_containing(addr)
+//    Return a copy of the active block containing `addr`, if any, using
+//    each shard's radix index to find its closest block at or below `addr`.
+static bool m61_find_containing(uintptr_t addr, m61_block* result) {
+    bool found = false;
+    unsigned sbits = (addr >> 4) % M61_NSHARDS;
+    for (unsigned s = 0; s != M61_NSHARDS; ++s) {
+        // largest key in shard `s` whose block address is <= addr
+        uint64_t key = addr >> 10;
+        if (s > sbits) {
+            if (key == 0) {
+                continue;
+            }
+            --key;
+        }
+        m61_table_shard& ts = block_table[s];
+        std::lock_guard<m61_mutex> guard(ts.lock);
+        uint64_t k;
+        if (ts.starts.predecessor(key, &k)) {
+            m61_block* b = ts.lookup((k << 10) | (s << 4));
+            assert(b && b->active);
+            // blocks do not overlap, so at most one shard can match
+            if (addr < b->addr + b->size) {
+                *result = *b;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+
+// m61_site_registry
+//    Dense ids for allocation sites. A site is identified by its `file`
+//    pointer and line, never by the file name's text, so finding a site
+//    hashes and compares two words. Ids count up from 1 and are never
+//    reused, so per-site data can live in flat arrays indexed by id. The
+//    index is lock-free like `stack_table`: a thread claims an empty
+//    index slot, takes the next id, records the site, then publishes the
+//    id. Id 0 means the registry is full. Equal file names at different
+//    addresses get different ids; reports merge them by name.
+
+#define M61_SITE_NIDS       4096
+#define M61_SITE_INDEXSIZE  (2 * M61_SITE_NIDS)
+#define M61_SITE_WRITING    UINT32_MAX          // index slot being filled
+#define M61_SITE_LOST       (UINT32_MAX - 1)    // index slot claimed when full
+
+struct m61_site_key {
+    const char* file;
+    long line;
+};
+
+static m61_site_key site_keys[M61_SITE_NIDS];  // by id; entry 0 is unused
+static std::atomic<uint32_t> site_index[M61_SITE_INDEXSIZE];  // 0 if empty
+static std::atomic<uint32_t> site_nids{1};
+
+static_assert(M61_SITE_INDEXSIZE == 8192, "m61_site_id assumes 13 bits");
+
+// m61_site_id(file, line)
+//    Return the id of site `file`:`line`, registering it if necessary,
+//    or 0 if the registry is full.
+static uint32_t m61_site_id(const char* file, long line) {
+    uint64_t h = (reinterpret_cast<uintptr_t>(file) ^ (uint64_t(line) << 40))
+        * 0x9E3779B97F4A7C15ULL;
+    for (size_t n = 0, i = h >> 51; n != M61_SITE_INDEXSIZE; ++n, ++i) {
+        std::atomic<uint32_t>& slot = site_index[i % M61_SITE_INDEXSIZE];
+        uint32_t id = slot.load(std::memory_order_acquire);
+        if (id == 0) {
+            if (site_nids.load(std::memory_order_relaxed) >= M61_SITE_NIDS) {
+                return 0;
+            } else if (slot.compare_exchange_strong(id, M61_SITE_WRITING)) {
+                id = site_nids.fetch_add(1, std::memory_order_relaxed);
+                if (id >= M61_SITE_NIDS) {
+                    slot.store(M61_SITE_LOST, std::memory_order_release);
+                    return 0;
+                }
+                site_keys[id] = {file, line};
+                slot.store(id, std::memory_order_release);
+                return id;
+            }
+        }
+        while (id == M61_SITE_WRITING) {
+            id = slot.load(std::memory_order_acquire);
+        }
+        if (id < M61_SITE_NIDS
+            && site_keys[id].file == file && site_keys[id].line == line) {
+            return id;
+        }
+    }
+    return 0;
+}
+
+// m61_site_counts
+//    One thread's exact allocation count and bytes for every registered
+//    site, indexed by site id.
+struct m61_site_counts {
+    std::atomic<unsigned long long> count[M61_SITE_NIDS];
+    std::atomic<unsigned long long> size[M61_SITE_NIDS];
+};
+
+
+// m61_hh_table
+//    Bounded-memory heavy-hitter tracker using the Space-Saving algorithm
+//    (Metwally, Agrawal & El Abbadi). The table holds a fixed number of
+//    counters, each keyed by allocation site. A hit adds to the site's
+//    counter. A miss evicts the smallest counter, and the new site
+//    inherits that counter's value, which becomes its error bound. Each
+//    estimate is therefore too large by at most `total / M61_HH_NCOUNTERS`,
+//    and every site above that share is guaranteed to be present, however
+//    many sites exist. A min-heap finds the victim and a small
+//    open-addressed index finds a site's counter, so an update costs
+//    O(log M61_HH_NCOUNTERS) with no allocation.
+
+#define M61_HH_NCOUNTERS    64
+#define M61_HH_INDEXSIZE    (2 * M61_HH_NCOUNTERS)
+
+struct m61_hh_counter {
+    const char* file;
+    long line;
+    unsigned long long weight;          // estimated total for this site
+    unsigned long long error;           // maximum overestimate of `weight`
+};
+
+struct m61_hh_table {
+    m61_hh_counter c[M61_HH_NCOUNTERS];
+    unsigned char heap[M61_HH_NCOUNTERS];   // counter indexes, min-heap by weight
+    unsigned char pos[M61_HH_NCOUNTERS];    // heap position of each counter
+    unsigned char index[M61_HH_INDEXSIZE] = {};  // site hash -> counter index + 1
+    int n = 0;
+    unsigned long long total = 0;
+
+    void add(const char* file, long line, unsigned long long w);
+
+  private:
+    static unsigned hash(const char* file, long line) {
+        uint64_t h = (reinterpret_cast<uintptr_t>(file) ^ (uint64_t(line) << 40))
+            * 0x9E3779B97F4A7C15ULL;
+        return h >> 57;     // log2(M61_HH_INDEXSIZE) bits
+    }
+    void swap(int i, int j) {
+        std::swap(heap[i], heap[j]);
+        pos[heap[i]] = i;
+        pos[heap[j]] = j;
+    }
+    void sift_up(int i);
+    void sift_down(int i);
+    void unindex(int ci);
+};
+
+static_assert(M61_HH_INDEXSIZE == 128, "m61_hh_table::hash assumes 7 bits");
+
+void m61_hh_table::add(const char* file, long line, unsigned long long w) {
+    total += w;
+    unsigned h = hash(file, line);
+    for (; index[h] != 0; h = (h + 1) % M61_HH_INDEXSIZE) {
+        int ci = index[h] - 1;
+        if (c[ci].file == file && c[ci].line == line) {
+            c[ci].weight += w;
+            sift_down(pos[ci]);
+            return;
+        }
+    }
+    if (n < M61_HH_NCOUNTERS) {
+        // fill an unused counter
+        int ci = n;
+        ++n;
+        c[ci] = {file, line, w, 0};
+        heap[ci] = ci;
+        pos[ci] = ci;
+        index[h] = ci + 1;
+        sift_up(ci);
+    } else {
+        // replace the smallest counter
+        int ci = heap[0];
+        unindex(ci);
+        unsigned long long min = c[ci].weight;
+        c[ci] = {file, line, min + w, min};
+        for (h = hash(file, line); index[h] != 0; h = (h + 1) % M61_HH_INDEXSIZE) {
+        }
+        index[h] = ci + 1;
+        sift_down(0);
+    }
+}
+
+void m61_hh_table::sift_up(int i) {
+    while (i > 0 && c[heap[i]].weight < c[heap[(i - 1) / 2]].weight) {
+        swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void m61_hh_table::sift_down(int i) {
+    while (true) {
+        int m = i;
+        for (int k = 2 * i + 1; k <= 2 * i + 2 && k < n; ++k) {
+            if (c[heap[k]].weight < c[heap[m]].weight) {
+                m = k;
+            }
+        }
+        if (m == i) {
+            return;
+        }
+        swap(i, m);
+        i = m;
+    }
+}
+
+void m61_hh_table::unindex(int ci) {
+    // linear-probing deletion: shift later entries of the cluster back
+    unsigned i = hash(c[ci].file, c[ci].line);
+    while (index[i] != ci + 1) {
+        i = (i + 1) % M61_HH_INDEXSIZE;
+    }
+    index[i] = 0;
+    for (unsigned j = (i + 1) % M61_HH_INDEXSIZE; index[j] != 0;
+         j = (j + 1) % M61_HH_INDEXSIZE) {
+        const m61_hh_counter& cj = c[index[j] - 1];
+        unsigned home = hash(cj.file, cj.line);
+        // leave entry `j` alone if its home lies cyclically in (i, j]
+        if ((i < j && (home <= i || home > j))
+            || (i > j && home <= i && home > j)) {
+            index[i] = index[j];
+            index[j] = 0;
+            i = j;
+        }
+    }
+}
+
+
+// m61_life_table
+//    Per-thread lifetime profile of allocation sites. For each site it
+//    keeps a log2 histogram of the cycles between allocation and free,
+//    the range of sizes, and how many frees came in LIFO order. LIFO
+//    order is judged against a short per-site stack of the birth times of
+//    the site's youngest live blocks on this thread; freeing anything but
+//    the top of the stack, or freeing on another thread, is out of order.
+//    A block too old to be on the stack is in order once the stack is
+//    empty.
+
+#define M61_LIFE_NSITES     128         // sites per thread; more are dropped
+#define M61_LIFE_NBUCKETS   48
+#define M61_LIFE_STACK      16
+
+struct m61_life_site {
+    const char* file;                   // nullptr marks an empty slot
+    long line;
+    unsigned long long nalloc;
+    unsigned long long nfree;
+    unsigned long long nlifo;           // frees of the youngest live block
+    size_t min_size;
+    size_t max_size;
+    unsigned long long hist[M61_LIFE_NBUCKETS]; // frees by log2(lifetime)
+    uint64_t stack[M61_LIFE_STACK];     // birth times, youngest last
+    unsigned depth;
+};
+
+struct m61_life_table {
+    m61_life_site sites[M61_LIFE_NSITES];
+    unsigned long long ndropped;        // events at sites that did not fit
+
+    // return the entry for `file`:`line`, or nullptr if the table is full
+    m61_life_site* find(const char* file, long line) {
+        size_t h = (reinterpret_cast<uintptr_t>(file) * 31 + line)
+            * 0x9E3779B97F4A7C15ULL >> 57;
+        for (size_t n = 0; n != M61_LIFE_NSITES; ++n, ++h) {
+            m61_life_site& s = sites[h % M61_LIFE_NSITES];
+            if (s.file == file && s.line == line) {
+                return &s;
+            } else if (!s.file) {
+                s.file = file;
+                s.line = line;
+                s.min_size = SIZE_MAX;
+                return &s;
+            }
+        }
+        ++ndropped;
+        return nullptr;
+    }
+};
+static_assert(M61_LIFE_NSITES == 128, "m61_life_table::find assumes 7 bits");
+
+
+// m61_quarantine
+//    Per-thread FIFO of freed blocks, filled with a poison pattern, that
+//    are held back from the base allocator until more than `budget`
+//    bytes are queued behind them. A block leaving the quarantine is
+//    checked for the pattern, so a write after free is caught even if it
+//    happened long after the free.
+struct m61_quarantine_entry {
+    uintptr_t addr;
+    size_t size;
+    const char* file;                   // free site
+    long line;
+};
+
+struct m61_quarantine {
+    m61_quarantine_entry* slots = nullptr;
+    size_t capacity = 0;                // 0 or a power of 2
+    size_t head = 0;                    // index of oldest entry
+    size_t n = 0;
+    size_t bytes = 0;                   // # bytes in queued blocks
+};
+
+
+// m61_stats_shard
+//    Statistics for one thread. Only the owning thread writes its shard,
+//    so the hot path uses relaxed loads and stores with no lock and no
+//    locked instruction; `m61_get_statistics` sums every shard. A block
+//    freed by another thread is subtracted from *that* thread's shard, so
+//    a single shard's active counts may wrap, but the sum is exact.
+//    Shards outlive their threads and are reclaimed by new threads, so
+//    totals are never lost.
+struct m61_stats_shard {
+    std::atomic<unsigned long long> nactive{0};
+    std::atomic<unsigned long long> active_size{0};
+    std::atomic<unsigned long long> ntotal{0};
+    std::atomic<unsigned long long> total_size{0};
+    std::atomic<unsigned long long> nfail{0};
+    std::atomic<unsigned long long> fail_size{0};
+    std::atomic<unsigned long long> nactive_by_class[M61_NSIZECLASSES] = {};
+    std::atomic<unsigned long long> ntotal_by_class[M61_NSIZECLASSES] = {};
+    // peak tracking: see `m61_track_active`
+    long long unflushed = 0;
+    long long flushed_seen = 0;
+    std::atomic<long long> peak{0};
+    // heavy hitters by allocation count and by bytes: exact counts by
+    // site id, allocated on first use, and Space-Saving tables for sites
+    // that did not fit in the registry. `hh_lock` is only contended while
+    // a report copies the tables
+    std::atomic<m61_site_counts*> sites{nullptr};
+    std::atomic_flag hh_lock = ATOMIC_FLAG_INIT;
+    m61_hh_table hh_count;
+    m61_hh_table hh_size;
+    // lifetime profile, allocated on first use; `life_lock` likewise
+    // guards against a concurrent report
+    std::atomic_flag life_lock = ATOMIC_FLAG_INIT;
+    std::atomic<m61_life_table*> life{nullptr};
+    m61_quarantine quarantine;          // touched only by the owner
+    std::atomic<bool> owned{true};
+    m61_stats_shard* next = nullptr;
+};
+
+static std::atomic<m61_stats_shard*> stats_shards;
+static thread_local m61_stats_shard* local_shard;
+
+static void m61_quarantine_drain(m61_quarantine& q, size_t budget);
+
+// m61_stats_owner: releases this thread's shard when the thread exits,
+// after returning its quarantined blocks.
+struct m61_stats_owner {
+    ~m61_stats_owner() {
+        if (m61_stats_shard* s = local_shard) {
+            m61_quarantine_drain(s->quarantine, 0);
+            local_shard = nullptr;
+            s->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+static thread_local m61_stats_owner local_stats_owner;
+
+static m61_stats_shard* m61_claim_shard() {
+    (void) &local_stats_owner;  // register the thread-exit hook
+    // claim a shard left behind by an exited thread, or make a new one
+    m61_stats_shard* s = stats_shards.load(std::memory_order_acquire);
+    for (; s; s = s->next) {
+        bool expected = false;
+        if (!s->owned.load(std::memory_order_relaxed)
+            && s->owned.compare_exchange_strong(expected, true)) {
+            break;
+        }
+    }
+    if (!s) {
+        s = new m61_stats_shard;
+        s->next = stats_shards.load(std::memory_order_relaxed);
+        while (!stats_shards.compare_exchange_weak(s->next, s)) {
+        }
+    }
+    local_shard = s;
+    return s;
+}
+
+static inline m61_stats_shard* m61_local_shard() {
+    m61_stats_shard* s = local_shard;
+    return s ? s : m61_claim_shard();
+}
+
+// add to a statistic written only by this thread
+template <typename T>
+static inline void m61_stat_add(std::atomic<T>& x, T delta) {
+    x.store(x.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+}
+
+// m61_size_class(sz)
+//    Return the power-of-two histogram class of `sz`.
+static inline int m61_size_class(size_t sz) {
+    return sz <= 1 ? 0 : 64 - __builtin_clzll(sz - 1);
+}
+
+// m61_track_active(s, delta)
+//    Track peak active bytes without a shared write per operation. Each
+//    shard batches its changes into `active_flushed` once they reach
+//    `M61_PEAK_BATCH` bytes, and records the peak of the last global
+//    value it saw plus its own unflushed bytes. With one thread this is
+//    exact; otherwise it can miss up to `M61_PEAK_BATCH` bytes per other
+//    thread.
+
+#define M61_PEAK_BATCH      (64 << 10)
+
+static std::atomic<long long> active_flushed;
+
+static inline void m61_track_active(m61_stats_shard* s, long long delta) {
+    s->unflushed += delta;
+    if (s->unflushed >= M61_PEAK_BATCH || s->unflushed <= -M61_PEAK_BATCH) {
+        s->flushed_seen = active_flushed.fetch_add(s->unflushed) + s->unflushed;
+        s->unflushed = 0;
+    }
+    long long now = s->flushed_seen + s->unflushed;
+    if (now > s->peak.load(std::memory_order_relaxed)) {
+        s->peak.store(now, std::memory_order_relaxed);
+    }
+}
+
+// Statistics and heavy-hitter updates. Each compiles to nothing when its
+// feature is disabled.
+// count `n` blocks of `sz` bytes
+static inline void m61_count_alloc_many(unsigned long long n, size_t sz) {
+    if constexpr (m61_config::statistics) {
+        m61_stats_shard* s = m61_local_shard();
+        m61_stat_add(s->nactive, n);
+        m61_stat_add(s->active_size, n * sz);
+        m61_stat_add(s->ntotal, n);
+        m61_stat_add(s->total_size, n * sz);
+        int sc = m61_size_class(sz);
+        m61_stat_add(s->nactive_by_class[sc], n);
+        m61_stat_add(s->ntotal_by_class[sc], n);
+        m61_track_active(s, n * sz);
+    }
+}
+
+static inline void m61_count_alloc(size_t sz) {
+    m61_count_alloc_many(1, sz);
+}
+
+static inline void m61_count_free(size_t sz) {
+    if constexpr (m61_config::statistics) {
+        m61_stats_shard* s = m61_local_shard();
+        m61_stat_add(s->nactive, -1ULL);
+        m61_stat_add(s->active_size, -(unsigned long long) sz);
+        m61_stat_add(s->nactive_by_class[m61_size_class(sz)], -1ULL);
+        m61_track_active(s, -(long long) sz);
+    }
+}
+
+// free many objects at once; `nbyclass` is their size-class histogram
+static inline void m61_count_free_many(unsigned long long n, unsigned long long sz,
+                                       const unsigned long long* nbyclass) {
+    if constexpr (m61_config::statistics) {
+        m61_stats_shard* s = m61_local_shard();
+        m61_stat_add(s->nactive, -n);
+        m61_stat_add(s->active_size, -sz);
+        for (int sc = 0; sc != M61_NSIZECLASSES; ++sc) {
+            m61_stat_add(s->nactive_by_class[sc], -nbyclass[sc]);
+        }
+        m61_track_active(s, -(long long) sz);
+    }
+}
+
+// count `n` failed allocations of `sz` bytes
+static inline void m61_count_fail(unsigned long long sz,
+                                  unsigned long long n = 1) {
+    if constexpr (m61_config::statistics) {
+        m61_stats_shard* s = m61_local_shard();
+        m61_stat_add(s->nfail, n);
+        // saturate, so a failed request too big to count stays visible
+        unsigned long long total = sz > ULLONG_MAX / n ? ULLONG_MAX : n * sz;
+        unsigned long long fsz = s->fail_size.load(std::memory_order_relaxed);
+        s->fail_size.store(fsz + std::min(total, ULLONG_MAX - fsz),
+                           std::memory_order_relaxed);
+    }
+}
+
+// count `n` allocations of `sz` bytes at `file`:`line`
+static inline void m61_count_site(const char* file, long line, size_t sz,
+                                  unsigned long long n = 1) {
+    if constexpr (m61_config::heavy_hitters) {
+        m61_stats_shard* s = m61_local_shard();
+        if (uint32_t id = m61_site_id(file, line)) {
+            m61_site_counts* sc = s->sites.load(std::memory_order_relaxed);
+            if (!sc) {
+                sc = new m61_site_counts();
+                s->sites.store(sc, std::memory_order_release);
+            }
+            m61_stat_add(sc->count[id], n);
+            m61_stat_add(sc->size[id], n * sz);
+            return;
+        }
+        while (s->hh_lock.test_and_set(std::memory_order_acquire)) {
+        }
+        s->hh_count.add(file, line, n);
+        s->hh_size.add(file, line, n * sz);
+        s->hh_lock.clear(std::memory_order_release);
+    }
+}
+
+// Boundary canaries
+//    Every block is followed by `M61_CANARY_SIZE` bytes of a fixed
+//    pattern, checked when the block is freed. (Guard-page blocks use the
+//    pattern to fill their alignment slack, up to 15 bytes.)
+
+#define M61_CANARY_SIZE     8
+
+// bytes reserved after each block for its canary
+static constexpr size_t m61_canary_size = m61_config::canaries ? M61_CANARY_SIZE : 0;
+
+static const unsigned char m61_canary[16] = {
+    0xCB, 0x61, 0xA5, 0x3C, 0xCB, 0x61, 0xA5, 0x3C,
+    0xCB, 0x61, 0xA5, 0x3C, 0xCB, 0x61, 0xA5, 0x3C
+};
+
+static inline void m61_canary_write(uintptr_t addr, size_t n) {
+    memcpy(reinterpret_cast<void*>(addr), m61_canary, n);
+}
+
+static inline bool m61_canary_ok(uintptr_t addr, size_t n) {
+    return memcmp(reinterpret_cast<void*>(addr), m61_canary, n) == 0;
+}
+
+
+// Quarantine
+//    See `m61_quarantine`. The budget applies to each thread separately;
+//    blocks larger than the budget skip the quarantine. Blocks of up to
+//    `M61_POISON_WHOLE` bytes are poisoned whole. Larger blocks, which the
+//    base allocator serves from their own pages, are poisoned only in
+//    their first and last `M61_POISON_EDGE` bytes, so a free touches a
+//    few pages at most and costs the same whatever the block's size.
+
+#define M61_QUARANTINE_BUDGET   (1 << 20)
+#define M61_POISON              0x6B
+#define M61_POISON_WHOLE        (8 << 10)
+#define M61_POISON_EDGE         1024
+
+static std::atomic<size_t> quarantine_budget{M61_QUARANTINE_BUDGET};
+
+// m61_poison_check(addr, n)
+//    Return the offset of the first byte in [addr, addr + n) that is not
+//    `M61_POISON`, or `n` if there is none. Compares 16 bytes at a time.
+static size_t m61_poison_check(uintptr_t addr, size_t n) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(addr);
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i poison = _mm_set1_epi8(char(M61_POISON));
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, poison)) != 0xFFFF) {
+            break;
+        }
+    }
+#endif
+    while (i != n && p[i] == M61_POISON) {
+        ++i;
+    }
+    return i;
+}
+
+// m61_quarantine_drain(q, budget)
+//    Check and release the oldest blocks in `q` until at most `budget`
+//    bytes remain.
+static void m61_quarantine_drain(m61_quarantine& q, size_t budget) {
+    while (q.bytes > budget) {
+        m61_quarantine_entry& e = q.slots[q.head];
+        size_t off;
+        if (e.size <= M61_POISON_WHOLE) {
+            off = m61_poison_check(e.addr, e.size);
+        } else if ((off = m61_poison_check(e.addr, M61_POISON_EDGE))
+                   == M61_POISON_EDGE) {
+            size_t tail = e.size - M61_POISON_EDGE;
+            off = tail + m61_poison_check(e.addr + tail, M61_POISON_EDGE);
+        }
+        if (off != e.size) {
+            fprintf(stderr, "MEMORY BUG: %s: write after free to pointer %p, "
+                    "%zu bytes inside a %zu byte region freed here\n",
+                    m61_site(e.file, e.line).s, reinterpret_cast<void*>(e.addr + off),
+                    off, e.size);
+            abort();
+        }
+        base_free(reinterpret_cast<void*>(e.addr));
+        q.bytes -= e.size;
+        q.head = (q.head + 1) & (q.capacity - 1);
+        --q.n;
+    }
+}
+
+// m61_quarantine_put(addr, sz, file, line)
+//    Poison and enqueue a freed block; return false if it should be
+//    released directly.
+static bool m61_quarantine_put(uintptr_t addr, size_t sz,
+                               const char* file, long line) {
+    size_t budget = quarantine_budget.load(std::memory_order_relaxed);
+    if (!m61_config::quarantine || sz > budget) {
+        return false;
+    }
+    m61_quarantine& q = m61_local_shard()->quarantine;
+    if (q.n == q.capacity) {
+        size_t ncapacity = q.capacity ? q.capacity * 2 : 64;
+        m61_quarantine_entry* nslots = new m61_quarantine_entry[ncapacity];
+        for (size_t i = 0; i != q.n; ++i) {
+            nslots[i] = q.slots[(q.head + i) & (q.capacity - 1)];
+        }
+        delete[] q.slots;
+        q.slots = nslots;
+        q.capacity = ncapacity;
+        q.head = 0;
+    }
+    if (sz <= M61_POISON_WHOLE) {
+        memset(reinterpret_cast<void*>(addr), M61_POISON, sz);
+    } else {
+        memset(reinterpret_cast<void*>(addr), M61_POISON, M61_POISON_EDGE);
+        memset(reinterpret_cast<void*>(addr + sz - M61_POISON_EDGE), M61_POISON,
+               M61_POISON_EDGE);
+    }
+    q.slots[(q.head + q.n) & (q.capacity - 1)] = {addr, sz, file, line};
+    ++q.n;
+    q.bytes += sz;
+    m61_quarantine_drain(q, budget);
+    return true;
+}
+
+
+/// m61_set_quarantine_size(bytes)
+///    Set the most bytes of freed blocks each thread holds in quarantine.
+///    0 disables the quarantine.
+
+void m61_set_quarantine_size(size_t bytes) {
+    quarantine_budget.store(bytes, std::memory_order_relaxed);
+    if (m61_stats_shard* s = local_shard) {
+        m61_quarantine_drain(s->quarantine, bytes);
+    }
+}
+
+
+/// m61_trim()
+///    Release free pages to the OS now. Blocks still in quarantine are
+///    not free, so their pages stay.
+
+size_t m61_trim() {
+    return base_trim();
+}
+
+
+// Guard-page sampling
+//    When enabled with `m61_set_guard_sampling(rate)`, one in every `rate`
+//    allocations of at most a page is served from a small mmap'd pool in
+//    which every slot page sits between two PROT_NONE guard pages. The
+//    block is placed at the end of its slot (16-byte aligned), so an
+//    overflow faults on the guard page at once; alignment slack is
+//    covered by canary bytes. A freed slot is made PROT_NONE and reused
+//    in FIFO order, so it stays protected while `M61_GUARD_NSLOTS - 1`
+//    other sampled blocks come and go, and any use after free faults. A
+//    SIGSEGV handler reports the fault with the block's allocation site.
+//    Unsampled allocations pay one thread-local countdown decrement.
+
+#define M61_GUARD_NSLOTS    256
+#define M61_PAGESIZE        4096
+
+struct m61_guard_slot {
+    uintptr_t addr;                     // block address
+    size_t size;
+    const char* file;                   // allocation site
+    long line;
+    const char* free_file;              // free site, if freed
+    long free_line;
+    bool active;
+};
+
+static std::atomic<unsigned long> guard_rate{m61_config::guard_sampling};
+static std::mutex guard_lock;
+static std::atomic<uintptr_t> guard_pool;   // first slot page; 0 until first use
+static m61_guard_slot guard_slots[M61_GUARD_NSLOTS];
+static unsigned guard_free[M61_GUARD_NSLOTS];   // FIFO of free slot indexes
+static unsigned guard_free_head, guard_nfree;
+static struct sigaction guard_old_sigsegv;
+static thread_local unsigned long guard_countdown;
+static thread_local uint64_t guard_rng;     // xorshift state; 0 until seeded
+
+static inline uintptr_t m61_guard_slot_page(unsigned i) {
+    return guard_pool + 2 * i * M61_PAGESIZE;
+}
+
+static inline bool m61_guard_contains(uintptr_t addr) {
+    uintptr_t pool = guard_pool.load(std::memory_order_relaxed);
+    return pool != 0 && addr - pool < 2 * M61_GUARD_NSLOTS * M61_PAGESIZE;
+}
+
+static void m61_guard_sigsegv(int signo, siginfo_t* si, void* context);
+
+static bool m61_guard_init() {
+    // pool layout: guard, slot 0, guard, slot 1, ..., slot N-1, guard
+    size_t len = (2 * M61_GUARD_NSLOTS + 1) * M61_PAGESIZE;
+    void* p = mmap(nullptr, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    for (unsigned i = 0; i != M61_GUARD_NSLOTS; ++i) {
+        guard_free[i] = i;
+    }
+    guard_nfree = M61_GUARD_NSLOTS;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = m61_guard_sigsegv;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, &guard_old_sigsegv);
+
+    guard_pool = reinterpret_cast<uintptr_t>(p) + M61_PAGESIZE;
+    return true;
+}
+
+// m61_guard_sample(sz)
+//    Return true if this allocation should be placed on a guard page.
+static inline bool m61_guard_sample(size_t sz) {
+    unsigned long rate = guard_rate.load(std::memory_order_relaxed);
+    if (rate == 0 || sz > M61_PAGESIZE) {
+        return false;
+    }
+    if (guard_countdown == 0 || guard_countdown > rate) {
+        // a private generator leaves the program's random() sequence alone
+        uint64_t x = guard_rng;
+        if (x == 0) {
+            x = reinterpret_cast<uintptr_t>(&guard_rng) ^ 0x9E3779B97F4A7C15ULL;
+        }
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        guard_rng = x;
+        guard_countdown = 1 + x % rate;
+    }
+    return --guard_countdown == 0;
+}
+
+static void* m61_guard_malloc(size_t sz, const char* file, long line, bool zero) {
+    std::lock_guard<std::mutex> guard(guard_lock);
+    if ((!guard_pool.load(std::memory_order_relaxed) && !m61_guard_init())
+        || guard_nfree == 0) {
+        return nullptr;
+    }
+    unsigned i = guard_free[guard_free_head];
+    guard_free_head = (guard_free_head + 1) % M61_GUARD_NSLOTS;
+    --guard_nfree;
+
+    uintptr_t page = m61_guard_slot_page(i);
+    if (mprotect(reinterpret_cast<void*>(page), M61_PAGESIZE,
+                 PROT_READ | PROT_WRITE) != 0) {
+        return nullptr;
+    }
+    uintptr_t addr = (page + M61_PAGESIZE - sz) & ~uintptr_t(15);
+    if (zero) {
+        memset(reinterpret_cast<void*>(addr), 0, sz);
+    }
+    m61_canary_write(addr + sz, page + M61_PAGESIZE - (addr + sz));
+    guard_slots[i] = {addr, sz, file, line, nullptr, 0, true};
+    return reinterpret_cast<void*>(addr);
+}
+
+static size_t m61_guard_free(uintptr_t addr, const char* file, long line) {
+    std::lock_guard<std::mutex> guard(guard_lock);
+    unsigned i = (addr - guard_pool) / (2 * M61_PAGESIZE);
+    mprotect(reinterpret_cast<void*>(m61_guard_slot_page(i)), M61_PAGESIZE,
+             PROT_NONE);
+    guard_slots[i].active = false;
+    guard_slots[i].free_file = file;
+    guard_slots[i].free_line = line;
+    guard_free[(guard_free_head + guard_nfree) % M61_GUARD_NSLOTS] = i;
+    ++guard_nfree;
+    return guard_slots[i].size;
+}
+
+static void m61_guard_sigsegv(int signo, siginfo_t* si, void* context) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(si->si_addr);
+    if (!m61_guard_contains(addr)) {
+        // not ours: pass it to the previous handler, staying installed
+        if (guard_old_sigsegv.sa_flags & SA_SIGINFO) {
+            guard_old_sigsegv.sa_sigaction(signo, si, context);
+        } else if (guard_old_sigsegv.sa_handler != SIG_DFL
+                   && guard_old_sigsegv.sa_handler != SIG_IGN) {
+            guard_old_sigsegv.sa_handler(signo);
+        } else {
+            // fault again with the default action (a fault cannot be
+            // ignored)
+            signal(signo, SIG_DFL);
+        }
+        return;
+    }
+    // slot i is page 2i of the pool; guard page 2i+1 follows it. The slot
+    // is read without `guard_lock`, which a handler cannot take, so copy
+    // it first.
+    unsigned page = (addr - guard_pool) / M61_PAGESIZE;
+    m61_guard_slot gs = guard_slots[page / 2];
+    char buf[512];
+    m61_printer pr(buf, sizeof(buf));
+    pr << "MEMORY BUG: wild access to pointer ";
+    pr.hex(addr);
+    if (!gs.file) {
+        pr << ", not allocated\n";
+    } else if (page % 2 == 1) {
+        pr << ", heap buffer overflow\n  ";
+        m61_write_site(pr, gs.file, gs.line);
+        pr << ": ";
+        pr.hex(addr) << " is "
+            << static_cast<unsigned long long>(addr - (gs.addr + gs.size))
+            << " bytes past the end of a "
+            << static_cast<unsigned long long>(gs.size)
+            << " byte region allocated here\n";
+    } else {
+        pr << ", use after free\n  ";
+        m61_write_site(pr, gs.file, gs.line);
+        pr << ": ";
+        pr.hex(addr) << " is " << static_cast<unsigned long long>(addr - gs.addr)
+            << " bytes inside a " << static_cast<unsigned long long>(gs.size)
+            << " byte region allocated here\n  ";
+        m61_write_site(pr, gs.free_file, gs.free_line);
+        pr << ": region freed here\n";
+    }
+    pr.flush(STDERR_FILENO);
+    signal(signo, SIG_DFL);
+    abort();
+}
+
+
+/// m61_set_guard_sampling(rate)
+///    Place one in every `rate` allocations on a guard page, so that
+///    overflows and uses after free fault immediately. 0 disables sampling.
+
+void m61_set_guard_sampling(unsigned long rate) {
+    guard_rate.store(rate, std::memory_order_relaxed);
+}
+
+
+// Allocation tracing
+//    `m61_trace_open` maps a file as a ring of `m61_trace_record`s, and
+//    every m61_malloc, m61_calloc and m61_free appends one record while
+//    the trace is open. Appends claim a ring slot with one atomic add, so
+//    threads never wait for each other. When the ring is full, the oldest
+//    records are overwritten. `m61replay` replays a trace.
+
+static std::atomic<m61_trace_header*> trace;
+static std::atomic<uint64_t> trace_next_id;
+
+static inline uint64_t m61_rdtsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+static inline uint32_t m61_trace_site(const char* file, long line) {
+    uint64_t h = (reinterpret_cast<uintptr_t>(file) ^ (uint64_t(line) << 40))
+        * 0x9E3779B97F4A7C15ULL;
+    return h >> 32;
+}
+
+static void m61_trace_event(m61_trace_header* th, uint32_t op, size_t sz,
+                            uint64_t id, const char* file, long line) {
+    m61_trace_record* recs = reinterpret_cast<m61_trace_record*>(th + 1);
+    uint64_t i = __atomic_fetch_add(&th->nwritten, 1, __ATOMIC_RELAXED);
+    recs[i % th->capacity] = {m61_rdtsc(), sz, id, m61_trace_site(file, line), op};
+}
+
+// m61_trace_remember(addr, id), m61_trace_forget(addr)
+//    Without a side table, frees could not find the trace ids of their
+//    blocks. These keep the ids of traced blocks in the (otherwise unused)
+//    block table instead; with a side table they do nothing, since the
+//    side table already holds the ids. `m61_trace_forget` returns the id
+//    of the block at `addr`, or 0 if it was not traced, and must run
+//    before the block is released.
+
+static std::atomic<bool> trace_untracked;   // an id was ever remembered
+
+static inline void m61_trace_remember(uintptr_t addr, uint64_t id) {
+    if constexpr (!m61_track_blocks) {
+        if (id) {
+            trace_untracked.store(true, std::memory_order_relaxed);
+            m61_table_shard& ts = m61_shard(addr);
+            std::lock_guard<m61_mutex> guard(ts.lock);
+            *ts.insert(addr) = {addr, 0, nullptr, 0, id, 0, 0, true};
+        }
+    }
+}
+
+static inline uint64_t m61_trace_forget(uintptr_t addr) {
+    if constexpr (!m61_track_blocks) {
+        if (trace_untracked.load(std::memory_order_relaxed)) {
+            m61_table_shard& ts = m61_shard(addr);
+            std::lock_guard<m61_mutex> guard(ts.lock);
+            m61_block* b = ts.lookup(addr);
+            if (b && b->active) {
+                b->active = false;
+                return b->trace_id;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// Lifetime profiling
+//    m61_life_alloc and m61_life_free update this thread's lifetime
+//    profile; they compile to nothing without the lifetimes feature.
+
+static m61_life_table* m61_local_life(m61_stats_shard* s) {
+    m61_life_table* lt = s->life.load(std::memory_order_relaxed);
+    if (!lt) {
+        lt = new m61_life_table();
+        s->life.store(lt, std::memory_order_release);
+    }
+    return lt;
+}
+
+static inline void m61_life_alloc(const char* file, long line, size_t sz,
+                                  uint64_t birth) {
+    if constexpr (m61_config::lifetimes) {
+        m61_stats_shard* s = m61_local_shard();
+        m61_life_table* lt = m61_local_life(s);
+        while (s->life_lock.test_and_set(std::memory_order_acquire)) {
+        }
+        if (m61_life_site* ls = lt->find(file, line)) {
+            ++ls->nalloc;
+            ls->min_size = std::min(ls->min_size, sz);
+            ls->max_size = std::max(ls->max_size, sz);
+            if (ls->depth == M61_LIFE_STACK) {
+                // forget the oldest
+                memmove(&ls->stack[0], &ls->stack[1],
+                        sizeof(uint64_t) * (M61_LIFE_STACK - 1));
+                --ls->depth;
+            }
+            ls->stack[ls->depth] = birth;
+            ++ls->depth;
+        }
+        s->life_lock.clear(std::memory_order_release);
+    }
+}
+
+static inline void m61_life_free(const char* file, long line, uint64_t birth) {
+    if constexpr (m61_config::lifetimes) {
+        uint64_t now = m61_rdtsc();
+        m61_stats_shard* s = m61_local_shard();
+        m61_life_table* lt = m61_local_life(s);
+        while (s->life_lock.test_and_set(std::memory_order_acquire)) {
+        }
+        if (m61_life_site* ls = lt->find(file, line)) {
+            ++ls->nfree;
+            uint64_t life = now > birth ? now - birth : 0;
+            int bucket = life ? 63 - __builtin_clzll(life) : 0;
+            ++ls->hist[std::min(bucket, M61_LIFE_NBUCKETS - 1)];
+            unsigned i = ls->depth;
+            while (i != 0 && ls->stack[i - 1] != birth) {
+                --i;
+            }
+            if (i != 0) {
+                ls->nlifo += i == ls->depth;
+                memmove(&ls->stack[i - 1], &ls->stack[i],
+                        sizeof(uint64_t) * (ls->depth - i));
+                --ls->depth;
+            } else {
+                // fell off the stack: LIFO if every younger block is gone
+                ls->nlifo += ls->depth == 0;
+            }
+        }
+        s->life_lock.clear(std::memory_order_release);
+    }
+}
+
+
+/// m61_trace_open(filename, nrecords)
+///    Start recording allocation events into `filename`, a memory-mapped
+///    ring holding `nrecords` records. Returns false on error.
+
+bool m61_trace_open(const char* filename, size_t nrecords) {
+    m61_trace_close();
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return false;
+    }
+    size_t len = sizeof(m61_trace_header) + nrecords * sizeof(m61_trace_record);
+    void* p = MAP_FAILED;
+    if (nrecords != 0 && ftruncate(fd, len) == 0) {
+        p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    m61_trace_header* th = reinterpret_cast<m61_trace_header*>(p);
+    memcpy(th->magic, M61_TRACE_MAGIC, sizeof(th->magic));
+    th->capacity = nrecords;
+    th->nwritten = 0;
+    trace.store(th, std::memory_order_release);
+    return true;
+}
+
+
+/// m61_trace_close()
+///    Stop recording and unmap the trace file. No other thread may
+///    allocate concurrently.
+
+void m61_trace_close() {
+    if (m61_trace_header* th = trace.exchange(nullptr)) {
+        munmap(th, sizeof(m61_trace_header)
+               + th->capacity * sizeof(m61_trace_record));
+    }
+}
+
 
 /// m61_malloc(sz, file, line)
 ///    Return a pointer to `sz` bytes of newly-allocated dynamic memory.
@@ -12,10 +1610,119 @@
 ///    return a unique, newly-allocated pointer value. The allocation
 ///    request was at location `file`:`line`.
 
+static void* m61_malloc_op(size_t sz, const char* file, long line, uint32_t op,
+                           size_t align = 16);
+
 void* m61_malloc(size_t sz, const char* file, long line) {
-    (void) file, (void) line;   // avoid uninitialized variable warnings
-    // Your code here.
-    return base_malloc(sz);
+    m61_stack_site(file, line, __builtin_frame_address(0));
+    return m61_malloc_op(sz, file, line, m61_trace_malloc);
+}
+
+static void* m61_malloc_op(size_t sz, const char* file, long line, uint32_t op,
+                           size_t align) {
+    void* ptr = nullptr;
+    // calloc memory comes back zeroed, so memory already known to be zero
+    // is not cleared twice
+    bool zero = op == m61_trace_calloc;
+    // guard-page blocks are only 16-byte aligned
+    if (align <= 16 && m61_guard_sample(sz)) {
+        ptr = m61_guard_malloc(sz, file, line, zero);
+    }
+    if (!ptr && sz <= SIZE_MAX - m61_canary_size) {
+        if (align > 16) {
+            ptr = base_aligned_malloc(align, sz + m61_canary_size);
+        } else {
+            ptr = zero ? base_calloc(sz + m61_canary_size)
+                : base_malloc(sz + m61_canary_size);
+        }
+        if (m61_config::canaries && ptr) {
+            m61_canary_write(reinterpret_cast<uintptr_t>(ptr) + sz,
+                             M61_CANARY_SIZE);
+        }
+    }
+    if (!ptr) {
+        m61_count_fail(sz);
+        return nullptr;
+    }
+
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    m61_trace_header* th = trace.load(std::memory_order_acquire);
+    uint64_t trace_id = th ? 1 + trace_next_id.fetch_add(1) : 0;
+    uint64_t birth = m61_config::lifetimes ? m61_rdtsc() : 0;
+    if constexpr (m61_track_blocks) {
+        m61_table_shard& ts = m61_shard(addr);
+        std::lock_guard<m61_mutex> guard(ts.lock);
+        *ts.insert(addr) = {addr, sz, file, line, trace_id,
+                            generation.load(std::memory_order_relaxed), birth, true};
+        if constexpr (m61_index_blocks) {
+            ts.starts.insert(m61_radix_key(addr));
+        }
+    }
+    m61_trace_remember(addr, trace_id);
+    if (th) {
+        m61_trace_event(th, op, sz, trace_id, file, line);
+    }
+
+    m61_count_alloc(sz);
+    m61_count_site(file, line, sz);
+    m61_life_alloc(file, line, sz, birth);
+    return ptr;
+}
+
+
+// m61_invalid_free(ptr, file, line, double_free, what)
+//    Report an invalid free (or other operation `what`) of `ptr` and
+//    abort. A pointer inside an active block is reported along with that
+//    block's allocation site.
+[[noreturn]] static void m61_invalid_free(void* ptr, const char* file,
+                                          long line, bool double_free,
+                                          const char* what = "free") {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    m61_block b;
+    if (double_free) {
+        fprintf(stderr, "MEMORY BUG: %s: invalid %s of pointer %p, double free\n",
+                m61_site(file, line).s, what, ptr);
+    } else if (base_classify(ptr) == base_not_in_heap && !m61_guard_contains(addr)) {
+        fprintf(stderr, "MEMORY BUG: %s: invalid %s of pointer %p, not in heap\n",
+                m61_site(file, line).s, what, ptr);
+    } else {
+        fprintf(stderr, "MEMORY BUG: %s: invalid %s of pointer %p, not allocated\n",
+                m61_site(file, line).s, what, ptr);
+        if (m61_find_containing(addr, &b)) {
+            fprintf(stderr, "  %s: %p is %zu bytes inside a %zu byte region allocated here\n",
+                    m61_site(b.file, b.line).s, ptr, size_t(addr - b.addr), b.size);
+        }
+    }
+    abort();
+}
+
+
+// m61_invalid_size(ptr, file, line, sized, sz)
+//    Report a sized free of `ptr` whose size does not match, and abort.
+[[noreturn]] static void m61_invalid_size(void* ptr, const char* file, long line,
+                                          size_t sized, size_t sz) {
+    fprintf(stderr, "MEMORY BUG: %s: invalid free of pointer %p, "
+            "size %zu does not match allocated size %zu\n",
+            m61_site(file, line).s, ptr, sized, sz);
+    abort();
+}
+
+
+// m61_check_canary(b, guarded, what, file, line)
+//    Abort if the canary after active block `b` was overwritten; `what`
+//    names the operation that found it.
+static inline void m61_check_canary(const m61_block* b, bool guarded,
+                                    const char* what, const char* file, long line) {
+    if constexpr (m61_config::canaries) {
+        uintptr_t end = b->addr + b->size;
+        size_t nslack = ((end + 15) & ~uintptr_t(15)) - end;
+        if (guarded ? !m61_canary_ok(end, nslack)
+            : !m61_canary_ok(end, M61_CANARY_SIZE)) {
+            fprintf(stderr, "MEMORY BUG: %s: detected wild write during %s of pointer %p\n",
+                    m61_site(file, line).s, what, reinterpret_cast<void*>(b->addr));
+            abort();
+        }
+    }
 }
 
 
@@ -24,10 +1731,285 @@ void* m61_malloc(size_t sz, const char* file, long line) {
 ///    returned by a previous call to m61_malloc. If `ptr == NULL`,
 ///    does nothing. The free was called at location `file`:`line`.
 
+static void m61_free_op(void* ptr, const char* file, long line, size_t sized);
+
 void m61_free(void* ptr, const char* file, long line) {
-    (void) file, (void) line;   // avoid uninitialized variable warnings
-    // Your code here.
-    base_free(ptr);
+    m61_free_op(ptr, file, line, SIZE_MAX);
+}
+
+// m61_free_op(ptr, file, line, sized)
+//    Free `ptr`, whose size the caller claims is `sized` (SIZE_MAX if the
+//    caller does not know).
+static void m61_free_op(void* ptr, const char* file, long line, size_t sized) {
+    if (!ptr) {
+        return;
+    }
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    size_t sz = 0;
+    uint64_t trace_id = 0;
+    const char* alloc_file = nullptr;
+    long alloc_line = 0;
+    uint64_t birth = 0;
+    bool guarded = m61_guard_contains(addr);
+    if (m61_config::wild_free && !guarded
+        && base_classify(ptr) == base_not_in_heap) {
+        // rejected without a lookup
+        m61_invalid_free(ptr, file, line, false);
+    }
+    if constexpr (m61_track_blocks) {
+        m61_table_shard& ts = m61_shard(addr);
+        std::unique_lock<m61_mutex> guard(ts.lock);
+        m61_block* b = ts.lookup(addr);
+        if (!b || !b->active) {
+            guard.unlock();
+            if constexpr (m61_config::wild_free) {
+                m61_invalid_free(ptr, file, line, b != nullptr);
+            }
+            // unchecked: the base allocator reports what it can
+            base_free(ptr);
+            return;
+        }
+        sz = b->size;
+        if (m61_config::wild_free && sized != SIZE_MAX && sized != sz) {
+            guard.unlock();
+            m61_invalid_size(ptr, file, line, sized, sz);
+        }
+        trace_id = b->trace_id;
+        alloc_file = b->file;
+        alloc_line = b->line;
+        birth = b->birth;
+        m61_check_canary(b, guarded, "free", file, line);
+        b->active = false;
+        if constexpr (m61_index_blocks) {
+            ts.starts.erase(m61_radix_key(addr));
+        }
+    } else {
+        trace_id = m61_trace_forget(addr);
+    }
+
+    if (m61_trace_header* th = trace.load(std::memory_order_acquire)) {
+        if (trace_id) {
+            m61_trace_event(th, m61_trace_free, 0, trace_id, file, line);
+        }
+    }
+
+    if (guarded) {
+        sz = m61_guard_free(addr, file, line);
+    } else if constexpr (m61_track_blocks || !m61_config::statistics) {
+        if (!m61_quarantine_put(addr, sz, file, line)) {
+            base_free(ptr);
+        }
+    } else if (sized != SIZE_MAX) {
+        // no side table, but the caller knows the size
+        base_free(ptr);
+        sz = sized;
+    } else {
+        // no side table; the base allocator knows the size
+        sz = base_free_size(ptr);
+    }
+    m61_count_free(sz);
+    if (alloc_file) {
+        m61_life_free(alloc_file, alloc_line, birth);
+    }
+}
+
+
+/// m61_free_sized(ptr, sz, file, line)
+///    Free `ptr`, which was allocated with size `sz`. Like m61_free, but
+///    when m61 keeps no side table the size need not be looked up. When it
+///    does, the size is checked.
+
+void m61_free_sized(void* ptr, size_t sz, const char* file, long line) {
+    m61_free_op(ptr, file, line, sz);
+}
+
+
+// m61_group_by_shard(ptrs, n)
+//    Reorder `ptrs[0..n)`, `n <= M61_BATCH_CHUNK`, so pointers in the same
+//    side-table shard are adjacent (a counting sort on shard index). A
+//    batch then locks each shard once per chunk.
+#define M61_BATCH_CHUNK     256
+
+static void m61_group_by_shard(void** ptrs, size_t n) {
+    assert(n <= M61_BATCH_CHUNK);
+    unsigned start[M61_NSHARDS + 1] = {};
+    for (size_t i = 0; i != n; ++i) {
+        ++start[(reinterpret_cast<uintptr_t>(ptrs[i]) >> 4) % M61_NSHARDS + 1];
+    }
+    for (unsigned s = 0; s != M61_NSHARDS; ++s) {
+        start[s + 1] += start[s];
+    }
+    void* sorted[M61_BATCH_CHUNK];
+    for (size_t i = 0; i != n; ++i) {
+        sorted[start[(reinterpret_cast<uintptr_t>(ptrs[i]) >> 4) % M61_NSHARDS]++] = ptrs[i];
+    }
+    memcpy(ptrs, sorted, n * sizeof(void*));
+}
+
+// end of the run of same-shard pointers starting at `ptrs[i]`, within
+// its chunk
+static size_t m61_shard_run_end(void** ptrs, size_t i, size_t n) {
+    m61_table_shard* ts = &m61_shard(reinterpret_cast<uintptr_t>(ptrs[i]));
+    for (++i; i != n && i % M61_BATCH_CHUNK != 0
+             && &m61_shard(reinterpret_cast<uintptr_t>(ptrs[i])) == ts; ++i) {
+    }
+    return i;
+}
+
+
+/// m61_malloc_batch(n, sz, ptrs, file, line)
+///    Allocate `n` blocks of `sz` bytes each into `ptrs[0..n)` and return
+///    how many were allocated; the rest of `ptrs` is set to NULL. The
+///    batch is recorded with one statistics and heavy-hitter update, and
+///    one lock acquisition per side-table shard. Batch blocks are never
+///    placed on guard pages.
+
+size_t m61_malloc_batch(size_t n, size_t sz, void** ptrs,
+                        const char* file, long line) {
+    m61_stack_site(file, line, __builtin_frame_address(0));
+    size_t k = 0;
+    if (sz <= SIZE_MAX - m61_canary_size) {
+        for (; k != n && (ptrs[k] = base_malloc(sz + m61_canary_size)); ++k) {
+            if constexpr (m61_config::canaries) {
+                m61_canary_write(reinterpret_cast<uintptr_t>(ptrs[k]) + sz,
+                                 M61_CANARY_SIZE);
+            }
+        }
+    }
+    for (size_t i = k; i != n; ++i) {
+        ptrs[i] = nullptr;
+    }
+    if (k != n) {
+        m61_count_fail(sz, n - k);
+    }
+    if (k == 0) {
+        return 0;
+    }
+
+    m61_trace_header* th = trace.load(std::memory_order_acquire);
+    uint64_t trace_id = th ? 1 + trace_next_id.fetch_add(k) : 0;
+    uint64_t birth = m61_config::lifetimes ? m61_rdtsc() : 0;
+    if constexpr (m61_track_blocks) {
+        uint64_t gen = generation.load(std::memory_order_relaxed);
+        for (size_t i = 0; i != k; ) {
+            if (i % M61_BATCH_CHUNK == 0) {
+                m61_group_by_shard(ptrs + i, std::min(k - i, size_t(M61_BATCH_CHUNK)));
+            }
+            m61_table_shard& ts = m61_shard(reinterpret_cast<uintptr_t>(ptrs[i]));
+            size_t end = m61_shard_run_end(ptrs, i, k);
+            std::lock_guard<m61_mutex> guard(ts.lock);
+            for (; i != end; ++i) {
+                uintptr_t addr = reinterpret_cast<uintptr_t>(ptrs[i]);
+                *ts.insert(addr) = {addr, sz, file, line,
+                                    trace_id ? trace_id + i : 0, gen, birth + i, true};
+                if constexpr (m61_index_blocks) {
+                    ts.starts.insert(m61_radix_key(addr));
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i != k; ++i) {
+        if (th) {
+            m61_trace_remember(reinterpret_cast<uintptr_t>(ptrs[i]), trace_id + i);
+            m61_trace_event(th, m61_trace_malloc, sz, trace_id + i, file, line);
+        }
+        // distinct births let lifetime profiling match each free
+        m61_life_alloc(file, line, sz, birth + i);
+    }
+    m61_count_alloc_many(k, sz);
+    m61_count_site(file, line, sz, k);
+    return k;
+}
+
+
+/// m61_free_batch(ptrs, n, file, line)
+///    Free the `n` blocks in `ptrs`, which may include NULLs, with one
+///    statistics update and one lock acquisition per side-table shard.
+///    The order of `ptrs` is not preserved.
+
+void m61_free_batch(void** ptrs, size_t n, const char* file, long line) {
+    // guard-page blocks are freed one by one; drop them and NULLs
+    size_t k = 0;
+    for (size_t i = 0; i != n; ++i) {
+        if (ptrs[i] && m61_guard_contains(reinterpret_cast<uintptr_t>(ptrs[i]))) {
+            m61_free(ptrs[i], file, line);
+        } else if (ptrs[i]) {
+            ptrs[k++] = ptrs[i];
+        }
+    }
+
+    unsigned long long nfreed = 0, total = 0;
+    unsigned long long nbyclass[M61_NSIZECLASSES] = {};
+    if constexpr (m61_track_blocks) {
+        m61_trace_header* th = trace.load(std::memory_order_acquire);
+        m61_block freed[M61_BATCH_CHUNK];
+        for (size_t i = 0; i != k; ) {
+            if (i % M61_BATCH_CHUNK == 0) {
+                m61_group_by_shard(ptrs + i, std::min(k - i, size_t(M61_BATCH_CHUNK)));
+            }
+            m61_table_shard& ts = m61_shard(reinterpret_cast<uintptr_t>(ptrs[i]));
+            size_t end = m61_shard_run_end(ptrs, i, k);
+            size_t nf = 0;
+            {
+                // only mark the run's blocks freed while holding the lock
+                std::unique_lock<m61_mutex> guard(ts.lock);
+                for (; i != end; ++i, ++nf) {
+                    uintptr_t addr = reinterpret_cast<uintptr_t>(ptrs[i]);
+                    m61_block* b = ts.lookup(addr);
+                    if (!b || !b->active) {
+                        if constexpr (m61_config::wild_free) {
+                            guard.unlock();
+                            m61_invalid_free(ptrs[i], file, line, b != nullptr);
+                        }
+                        freed[nf] = {addr, 0, nullptr, 0, 0, 0, 0, false};
+                        continue;
+                    }
+                    freed[nf] = *b;
+                    b->active = false;
+                    if constexpr (m61_index_blocks) {
+                        ts.starts.erase(m61_radix_key(addr));
+                    }
+                }
+            }
+            for (size_t j = 0; j != nf; ++j) {
+                const m61_block& b = freed[j];
+                void* ptr = reinterpret_cast<void*>(b.addr);
+                if (!b.active) {
+                    // unchecked: the base allocator reports what it can
+                    base_free(ptr);
+                    continue;
+                }
+                m61_check_canary(&b, false, "free", file, line);
+                if (th && b.trace_id) {
+                    m61_trace_event(th, m61_trace_free, 0, b.trace_id, file, line);
+                }
+                m61_life_free(b.file, b.line, b.birth);
+                ++nfreed;
+                total += b.size;
+                ++nbyclass[m61_size_class(b.size)];
+                if (!m61_quarantine_put(b.addr, b.size, file, line)) {
+                    base_free(ptr);
+                }
+            }
+        }
+    } else {
+        m61_trace_header* th = trace.load(std::memory_order_acquire);
+        for (size_t i = 0; i != k; ++i) {
+            uint64_t trace_id = m61_trace_forget(reinterpret_cast<uintptr_t>(ptrs[i]));
+            if (th && trace_id) {
+                m61_trace_event(th, m61_trace_free, 0, trace_id, file, line);
+            }
+            if constexpr (m61_config::statistics) {
+                size_t sz = base_free_size(ptrs[i]);
+                ++nfreed;
+                total += sz;
+                ++nbyclass[m61_size_class(sz)];
+            } else {
+                base_free(ptrs[i]);
+            }
+        }
+    }
+    m61_count_free_many(nfreed, total, nbyclass);
 }
 
 
@@ -39,51 +2021,1021 @@ void m61_free(void* ptr, const char* file, long line) {
 ///    location `file`:`line`.
 
 void* m61_calloc(size_t nmemb, size_t sz, const char* file, long line) {
-    // Your code here (to fix test019).
-    void* ptr = m61_malloc(nmemb * sz, file, line);
-    if (ptr) {
-        memset(ptr, 0, nmemb * sz);
+    if (sz != 0 && nmemb > SIZE_MAX / sz) {
+        // `nmemb * sz` would overflow; the true size does not fit in
+        // `fail_size`, so record it saturated
+        m61_count_fail(SIZE_MAX);
+        return nullptr;
+    }
+    m61_stack_site(file, line, __builtin_frame_address(0));
+    return m61_malloc_op(nmemb * sz, file, line, m61_trace_calloc);
+}
+
+
+// m61_resize(addr, sz, file, line, oldsz)
+//    Resize the active block at `addr` to `sz` bytes without moving it,
+//    if the base allocator can, and return true on success. Sets
+//    `*oldsz` to the block's size. A resized block is accounted as a free
+//    of the old block plus a new allocation at `file`:`line`.
+
+static bool m61_resize(uintptr_t addr, size_t sz, const char* file, long line,
+                       size_t* oldsz) {
+    void* ptr = reinterpret_cast<void*>(addr);
+    bool guarded = m61_guard_contains(addr);
+    bool fits = !guarded && sz <= SIZE_MAX - m61_canary_size;
+    m61_trace_header* th = trace.load(std::memory_order_acquire);
+    uint64_t old_trace_id = 0;
+    uint64_t trace_id = 0;
+    const char* alloc_file = nullptr;
+    long alloc_line = 0;
+    uint64_t old_birth = 0;
+    uint64_t birth = 0;
+    if constexpr (m61_track_blocks) {
+        m61_table_shard& ts = m61_shard(addr);
+        std::unique_lock<m61_mutex> guard(ts.lock);
+        m61_block* b = ts.lookup(addr);
+        if (!b || !b->active) {
+            guard.unlock();
+            if constexpr (m61_config::wild_free) {
+                m61_invalid_free(ptr, file, line, b != nullptr, "realloc");
+            }
+            *oldsz = 0;
+            return false;
+        }
+        *oldsz = b->size;
+        m61_check_canary(b, guarded, "realloc", file, line);
+        size_t basesz;
+        if (!fits || !base_resize(ptr, sz + m61_canary_size, &basesz)) {
+            return false;
+        }
+        if constexpr (m61_config::canaries) {
+            m61_canary_write(addr + sz, M61_CANARY_SIZE);
+        }
+        old_trace_id = b->trace_id;
+        alloc_file = b->file;
+        alloc_line = b->line;
+        old_birth = b->birth;
+        trace_id = th ? 1 + trace_next_id.fetch_add(1) : 0;
+        birth = m61_config::lifetimes ? m61_rdtsc() : 0;
+        *b = {addr, sz, file, line, trace_id,
+              generation.load(std::memory_order_relaxed), birth, true};
+    } else {
+        if (guarded) {
+            std::lock_guard<std::mutex> guard(guard_lock);
+            *oldsz = guard_slots[(addr - guard_pool) / (2 * M61_PAGESIZE)].size;
+            return false;
+        }
+        if (!base_resize(ptr, sz, oldsz)) {
+            return false;
+        }
+        old_trace_id = m61_trace_forget(addr);
+        trace_id = th ? 1 + trace_next_id.fetch_add(1) : 0;
+        m61_trace_remember(addr, trace_id);
+    }
+
+    if (th) {
+        if (old_trace_id) {
+            m61_trace_event(th, m61_trace_free, 0, old_trace_id, file, line);
+        }
+        m61_trace_event(th, m61_trace_malloc, sz, trace_id, file, line);
+    }
+    m61_count_free(*oldsz);
+    m61_count_alloc(sz);
+    m61_count_site(file, line, sz);
+    if (alloc_file) {
+        m61_life_free(alloc_file, alloc_line, old_birth);
+    }
+    m61_life_alloc(file, line, sz, birth);
+    return true;
+}
+
+
+/// m61_realloc(ptr, sz, file, line)
+///    Change the size of the block at `ptr` to `sz` bytes and return a
+///    pointer to it. The block stays in place if its size class (or, for
+///    a large block, the address space after it) has room; otherwise its
+///    contents move to a new block and `ptr` is freed. If `ptr == NULL`,
+///    acts like m61_malloc. On failure returns NULL and leaves `ptr`
+///    alone. The request was at location `file`:`line`.
+
+void* m61_realloc(void* ptr, size_t sz, const char* file, long line) {
+    m61_stack_site(file, line, __builtin_frame_address(0));
+    if (!ptr) {
+        return m61_malloc_op(sz, file, line, m61_trace_malloc);
+    }
+    size_t oldsz;
+    if (m61_resize(reinterpret_cast<uintptr_t>(ptr), sz, file, line, &oldsz)) {
+        return ptr;
+    }
+    void* nptr = m61_malloc_op(sz, file, line, m61_trace_malloc);
+    if (nptr) {
+        memcpy(nptr, ptr, std::min(oldsz, sz));
+        m61_free(ptr, file, line);
+    }
+    return nptr;
+}
+
+
+/// m61_aligned_alloc(align, sz, file, line)
+///    Return a pointer to `sz` bytes of newly-allocated dynamic memory
+///    whose address is a multiple of `align`. `align` must be a power of 2
+///    no larger than the page size; otherwise the allocation fails. The
+///    request was at location `file`:`line`.
+
+void* m61_aligned_alloc(size_t align, size_t sz, const char* file, long line) {
+    if (align == 0 || (align & (align - 1)) != 0 || align > M61_PAGESIZE) {
+        m61_count_fail(sz);
+        return nullptr;
+    }
+    m61_stack_site(file, line, __builtin_frame_address(0));
+    return m61_malloc_op(sz, file, line, m61_trace_malloc,
+                         std::max(align, size_t(16)));
+}
+
+
+/// m61_owns(ptr)
+///    Return true if `ptr` points into m61's heap, so that m61_free should
+///    see it even if it is not an active block: m61 then reports the bug,
+///    where the system allocator would corrupt its own heap.
+
+bool m61_owns(void* ptr) {
+    return m61_guard_contains(reinterpret_cast<uintptr_t>(ptr))
+        || base_classify(ptr) != base_not_in_heap;
+}
+
+
+/// m61_usable_size(ptr)
+///    Return the size of the active block `ptr`, or 0 if it is not one.
+
+size_t m61_usable_size(void* ptr) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    if constexpr (m61_track_blocks) {
+        m61_table_shard& ts = m61_shard(addr);
+        std::lock_guard<m61_mutex> guard(ts.lock);
+        m61_block* b = ts.lookup(addr);
+        return b && b->active ? b->size : 0;
+    }
+    if (m61_guard_contains(addr)) {
+        std::lock_guard<std::mutex> guard(guard_lock);
+        const m61_guard_slot& gs = guard_slots[(addr - guard_pool) / (2 * M61_PAGESIZE)];
+        return gs.active ? gs.size : 0;
+    }
+    size_t sz;
+    return base_lookup(ptr, &sz) ? sz : 0;
+}
+
+
+// m61_pool
+//    Slab pools for single objects allocated through m61_allocator. Each
+//    pool serves one slot size, a multiple of 16 up to M61_POOL_MAXSIZE,
+//    from slabs taken from the base allocator. A slot is a 16-byte header
+//    recording the allocation site, followed by the object; free slots are
+//    linked through the object's first word. Pool objects skip the side
+//    table, so allocation costs one uncontended lock and no hashing, and
+//    the leak report finds them by walking the slabs. Slabs are never
+//    returned.
+
+#define M61_POOL_SLABSIZE   (64 << 10)
+#define M61_POOL_NPOOLS     (M61_POOL_MAXSIZE / 16)
+
+#define M61_POOL_MAXLINE    ((1L << 23) - 1)
+
+struct m61_pool_slot {
+    const char* file;                   // allocation site; nullptr if free
+    uint32_t line : 23;                 // site id if `file == m61_pool_by_id`
+    uint32_t size : 9;                  // requested size
+    uint32_t generation;                // low bits of snapshot generation
+};
+static_assert(sizeof(m61_pool_slot) == 16, "pool objects must stay aligned");
+static_assert(M61_SITE_NIDS <= M61_POOL_MAXLINE, "site ids must fit in a slot");
+
+// Sites whose line does not fit in 23 bits (return addresses in preload and
+// retaddr modes) are stored as a site id under this sentinel file.
+static const char m61_pool_by_id[] = "?";
+
+// m61_pool_site(slot)
+//    Return the allocation site of the live object in `slot`.
+static inline m61_site_key m61_pool_site(const m61_pool_slot* slot) {
+    if (slot->file == m61_pool_by_id) {
+        return slot->line ? site_keys[slot->line] : m61_site_key{m61_pool_by_id, 0};
+    }
+    return {slot->file, long(slot->line)};
+}
+
+struct m61_pool_slab {
+    m61_pool_slab* next;
+    size_t pad;
+};
+
+struct m61_pool {
+    m61_mutex lock;
+    m61_pool_slab* slabs = nullptr;
+    m61_pool_slot* free_slots = nullptr;
+    m61_radix slab_starts;              // slab address >> 4, for m61_pool_free
+} __attribute__((aligned(64)));
+
+static m61_pool pools[M61_POOL_NPOOLS];
+
+static inline m61_pool_slot*& m61_pool_link(m61_pool_slot* slot) {
+    return *reinterpret_cast<m61_pool_slot**>(slot + 1);
+}
+
+// m61_pool_slab_slots(pool index)
+//    Return the number of slots in one slab of pool `pi`.
+static inline size_t m61_pool_slab_slots(size_t pi) {
+    return (M61_POOL_SLABSIZE - sizeof(m61_pool_slab))
+        / (sizeof(m61_pool_slot) + 16 * (pi + 1));
+}
+
+static inline m61_pool_slot* m61_pool_slab_slot(m61_pool_slab* sl, size_t pi,
+                                                size_t i) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(sl + 1);
+    return reinterpret_cast<m61_pool_slot*>(
+        start + i * (sizeof(m61_pool_slot) + 16 * (pi + 1)));
+}
+
+
+// m61_pool_contains(p, pi, slot)
+//    Return true iff `slot` is the start of a slot in one of the slabs of
+//    pool `p`, whose index is `pi`. Caller holds `p.lock`.
+static bool m61_pool_contains(const m61_pool& p, size_t pi,
+                              const m61_pool_slot* slot) {
+    uintptr_t addr = reinterpret_cast<uintptr_t>(slot);
+    uint64_t key;
+    if (!p.slab_starts.predecessor(addr >> 4, &key)) {
+        return false;
+    }
+    uintptr_t first = (uintptr_t(key) << 4) + sizeof(m61_pool_slab);
+    size_t stride = sizeof(m61_pool_slot) + 16 * (pi + 1);
+    return addr >= first
+        && (addr - first) % stride == 0
+        && (addr - first) / stride < m61_pool_slab_slots(pi);
+}
+
+
+/// m61_pool_alloc(sz, file, line)
+///    Return a pointer to one `sz`-byte object from a slab pool, allocated
+///    at location `file`:`line`.
+
+void* m61_pool_alloc(size_t sz, const char* file, long line) {
+    assert(sz <= M61_POOL_MAXSIZE);
+    m61_stack_site(file, line, __builtin_frame_address(0));
+    size_t pi = sz ? (sz - 1) / 16 : 0;
+    m61_pool& p = pools[pi];
+    m61_pool_slot* slot;
+    {
+        std::lock_guard<m61_mutex> guard(p.lock);
+        if (!p.free_slots) {
+            void* mem = base_malloc(M61_POOL_SLABSIZE);
+            if (!mem) {
+                m61_count_fail(sz);
+                return nullptr;
+            }
+            m61_pool_slab* sl = reinterpret_cast<m61_pool_slab*>(mem);
+            sl->next = p.slabs;
+            p.slabs = sl;
+            if (m61_config::wild_free) {
+                p.slab_starts.insert(reinterpret_cast<uintptr_t>(sl) >> 4);
+            }
+            for (size_t i = m61_pool_slab_slots(pi); i != 0; --i) {
+                m61_pool_slot* fresh = m61_pool_slab_slot(sl, pi, i - 1);
+                fresh->file = nullptr;
+                m61_pool_link(fresh) = p.free_slots;
+                p.free_slots = fresh;
+            }
+        }
+        slot = p.free_slots;
+        p.free_slots = m61_pool_link(slot);
+        *slot = {file, uint32_t(line), uint32_t(sz),
+                 uint32_t(generation.load(std::memory_order_relaxed))};
+        if (line < 0 || line > M61_POOL_MAXLINE) {
+            // id 0 (registry full) reads back as an unknown site
+            slot->file = m61_pool_by_id;
+            slot->line = m61_site_id(file, line);
+        }
+    }
+    m61_count_alloc(sz);
+    m61_count_site(file, line, sz);
+    return slot + 1;
+}
+
+
+/// m61_pool_free(ptr, sz, file, line)
+///    Free `ptr`, which must have been returned by m61_pool_alloc(sz, ...).
+///    If `ptr == NULL`, does nothing. The free was called at location
+///    `file`:`line`.
+
+void m61_pool_free(void* ptr, size_t sz, const char* file, long line) {
+    if (!ptr) {
+        return;
+    }
+    m61_pool_slot* slot = reinterpret_cast<m61_pool_slot*>(ptr) - 1;
+    size_t pi = sz ? (sz - 1) / 16 : 0;
+    m61_pool& p = pools[pi];
+    {
+        std::unique_lock<m61_mutex> guard(p.lock);
+        if (m61_config::wild_free && !m61_pool_contains(p, pi, slot)) {
+            guard.unlock();
+            m61_invalid_free(ptr, file, line, false);
+        }
+        if (m61_config::wild_free && !slot->file) {
+            guard.unlock();
+            m61_invalid_free(ptr, file, line, true);
+        }
+        slot->file = nullptr;
+        m61_pool_link(slot) = p.free_slots;
+        p.free_slots = slot;
+    }
+    m61_count_free(sz);
+}
+
+
+// m61_arena
+//    Objects are bump-allocated from chunks taken from the base allocator
+//    and are never freed one by one; m61_arena_destroy releases every chunk
+//    at once. Objects count in the statistics, but the side table never
+//    sees them, so the leak report lists a live arena as a single entry at
+//    its creation site; heavy-hitter counts also go to that site. Arenas
+//    are unlocked and meant for one thread at a time; only the list of
+//    live arenas is shared.
+
+#define M61_ARENA_CHUNKSIZE (64 << 10)
+
+struct m61_arena_chunk {
+    m61_arena_chunk* next;
+    size_t size;                        // # bytes, including this header
+};
+static_assert(sizeof(m61_arena_chunk) % 16 == 0, "chunk data must stay aligned");
+
+struct m61_arena {
+    m61_arena_chunk* chunks = nullptr;
+    uintptr_t next = 0;                 // next free byte of current chunk
+    uintptr_t limit = 0;                // end of current chunk
+    const char* file;                   // creation site
+    long line;
+    unsigned long long nalloc = 0;      // # objects allocated
+    unsigned long long size = 0;        // # bytes in objects allocated
+    unsigned long long nalloc_by_class[M61_NSIZECLASSES] = {};
+    uint64_t generation;                // snapshot generation at creation
+    m61_arena* prev_live;               // links in `live_arenas`
+    m61_arena* next_live;
+};
+
+static m61_mutex arena_lock;
+static m61_arena* live_arenas;
+
+
+/// m61_arena_create(file, line)
+///    Return a new, empty arena. The arena was created at location
+///    `file`:`line`.
+
+m61_arena* m61_arena_create(const char* file, long line) {
+    m61_arena* a = new m61_arena;
+    a->file = file;
+    a->line = line;
+    a->generation = generation.load(std::memory_order_relaxed);
+    a->prev_live = nullptr;
+    std::lock_guard<m61_mutex> guard(arena_lock);
+    a->next_live = live_arenas;
+    if (live_arenas) {
+        live_arenas->prev_live = a;
+    }
+    live_arenas = a;
+    return a;
+}
+
+
+/// m61_arena_alloc(arena, sz)
+///    Return a pointer to `sz` bytes of uninitialized memory from `arena`,
+///    aligned like m61_malloc memory. The memory stays valid until the
+///    arena is destroyed.
+
+void* m61_arena_alloc(m61_arena* a, size_t sz) {
+    // round up so that distinct objects have distinct addresses
+    size_t asz = ((sz ? sz : 1) + 15) & ~size_t(15);
+    void* ptr = nullptr;
+    if (sz > SIZE_MAX - 15 - sizeof(m61_arena_chunk)) {
+        // too big to fit in any chunk
+    } else if (asz <= a->limit - a->next) {
+        ptr = reinterpret_cast<void*>(a->next);
+        a->next += asz;
+    } else {
+        // objects too big to share a chunk get one of their own, and the
+        // current chunk stays current
+        size_t csz = std::max(size_t(M61_ARENA_CHUNKSIZE),
+                              asz + sizeof(m61_arena_chunk));
+        if (void* p = base_malloc(csz)) {
+            m61_arena_chunk* c = reinterpret_cast<m61_arena_chunk*>(p);
+            *c = {a->chunks, csz};
+            a->chunks = c;
+            ptr = c + 1;
+            if (csz == M61_ARENA_CHUNKSIZE) {
+                a->next = reinterpret_cast<uintptr_t>(c + 1) + asz;
+                a->limit = reinterpret_cast<uintptr_t>(c) + csz;
+            }
+        }
     }
+    if (!ptr) {
+        m61_count_fail(sz);
+        return nullptr;
+    }
+    a->nalloc += 1;
+    a->size += sz;
+    ++a->nalloc_by_class[m61_size_class(sz)];
+    m61_count_alloc(sz);
+    m61_count_site(a->file, a->line, sz);
     return ptr;
 }
 
 
+/// m61_arena_destroy(arena)
+///    Free every object allocated from `arena`, and the arena itself.
+///    Costs one base_free per chunk, however many objects there were. If
+///    `arena == NULL`, does nothing.
+
+void m61_arena_destroy(m61_arena* a) {
+    if (!a) {
+        return;
+    }
+    {
+        std::lock_guard<m61_mutex> guard(arena_lock);
+        if (a->prev_live) {
+            a->prev_live->next_live = a->next_live;
+        } else {
+            live_arenas = a->next_live;
+        }
+        if (a->next_live) {
+            a->next_live->prev_live = a->prev_live;
+        }
+    }
+    while (m61_arena_chunk* c = a->chunks) {
+        a->chunks = c->next;
+        base_free(c);
+    }
+    m61_count_free_many(a->nalloc, a->size, a->nalloc_by_class);
+    delete a;
+}
+
+
+// Fork handling
+//    A child process starts with one thread, a copy of the one that
+//    called fork. `m61_fork_prepare` takes every m61 and base allocator
+//    lock, so no locked structure is mid-update in the child. Each
+//    thread's own state is unlocked, though: in the child, the shards of
+//    the threads that did not survive are released for reuse, their
+//    quarantines forgotten (those blocks leak), and any lock-free table
+//    slot left half-written is given up.
+
+static void m61_fork_prepare() {
+    for (auto& p : pools) {
+        p.lock.lock();
+    }
+    arena_lock.lock();
+    for (auto& ts : block_table) {
+        ts.lock.lock();
+    }
+    guard_lock.lock();
+    for (m61_stats_shard* s = stats_shards.load(std::memory_order_acquire);
+         s; s = s->next) {
+        while (s->hh_lock.test_and_set(std::memory_order_acquire)) {
+        }
+        while (s->life_lock.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+    base_fork_prepare();
+}
+
+static void m61_fork_unlock() {
+    for (m61_stats_shard* s = stats_shards.load(std::memory_order_acquire);
+         s; s = s->next) {
+        s->life_lock.clear(std::memory_order_release);
+        s->hh_lock.clear(std::memory_order_release);
+    }
+    guard_lock.unlock();
+    for (auto& ts : block_table) {
+        ts.lock.unlock();
+    }
+    arena_lock.unlock();
+    for (auto& p : pools) {
+        p.lock.unlock();
+    }
+}
+
+static void m61_fork_parent() {
+    base_fork_parent();
+    m61_fork_unlock();
+}
+
+static void m61_fork_child() {
+    base_fork_child();
+    m61_fork_unlock();
+    for (m61_stats_shard* s = stats_shards.load(std::memory_order_relaxed);
+         s; s = s->next) {
+        if (s != local_shard && s->owned.load(std::memory_order_relaxed)) {
+            // the queue may have been mid-grow, so its array is abandoned
+            s->quarantine = m61_quarantine();
+            s->owned.store(false, std::memory_order_relaxed);
+        }
+    }
+    for (auto& s : stack_table) {
+        unsigned state = m61_stack::writing;
+        s.state.compare_exchange_strong(state, m61_stack::empty);
+    }
+    for (auto& slot : site_index) {
+        uint32_t id = M61_SITE_WRITING;
+        slot.compare_exchange_strong(id, M61_SITE_LOST);
+    }
+}
+
+static struct m61_fork_hooks {
+    m61_fork_hooks() {
+        pthread_atfork(m61_fork_prepare, m61_fork_parent, m61_fork_child);
+    }
+} fork_hooks;
+
+
 /// m61_get_statistics(stats)
 ///    Store the current memory statistics in `*stats`.
+///    Shards are summed without stopping other threads, so under
+///    concurrent allocation the result is a close, not atomic, snapshot.
 
 void m61_get_statistics(m61_statistics* stats) {
-    // Stub: set all statistics to enormous numbers
-    memset(stats, 255, sizeof(m61_statistics));
-    // Your code here.
+    memset(stats, 0, sizeof(m61_statistics));
+    for (m61_stats_shard* s = stats_shards.load(std::memory_order_acquire);
+         s; s = s->next) {
+        stats->nactive += s->nactive.load(std::memory_order_relaxed);
+        stats->active_size += s->active_size.load(std::memory_order_relaxed);
+        stats->ntotal += s->ntotal.load(std::memory_order_relaxed);
+        stats->total_size += s->total_size.load(std::memory_order_relaxed);
+        stats->nfail += s->nfail.load(std::memory_order_relaxed);
+        unsigned long long fsz = s->fail_size.load(std::memory_order_relaxed);
+        stats->fail_size += std::min(fsz, ULLONG_MAX - stats->fail_size);
+        for (int sc = 0; sc != M61_NSIZECLASSES; ++sc) {
+            stats->nactive_by_class[sc] += s->nactive_by_class[sc].load(std::memory_order_relaxed);
+            stats->ntotal_by_class[sc] += s->ntotal_by_class[sc].load(std::memory_order_relaxed);
+        }
+        long long peak = s->peak.load(std::memory_order_relaxed);
+        if (peak > 0 && (unsigned long long) peak > stats->peak_active_size) {
+            stats->peak_active_size = peak;
+        }
+    }
+    stats->peak_active_size = std::max(stats->peak_active_size, stats->active_size);
+    // Base allocator reuse counters; hit rate is nreuse / (nreuse + nfresh).
+    // The heap bounds are the base allocator's, widened to take in the
+    // guard-page pool.
+    base_allocator_statistics(stats);
+    if (uintptr_t pool = guard_pool.load(std::memory_order_relaxed)) {
+        uintptr_t end = pool + 2 * M61_GUARD_NSLOTS * M61_PAGESIZE;
+        stats->heap_min = stats->heap_max ? std::min(stats->heap_min, pool) : pool;
+        stats->heap_max = std::max(stats->heap_max, end);
+    }
 }
 
 
-/// m61_print_statistics()
-///    Print the current memory statistics.
+/// m61_print_statistics(f)
+///    Print the current memory statistics to `f`.
 
-void m61_print_statistics() {
+void m61_print_statistics(FILE* f) {
     m61_statistics stats;
     m61_get_statistics(&stats);
 
-    printf("alloc count: active %10llu   total %10llu   fail %10llu\n",
+    fprintf(f, "alloc count: active %10llu   total %10llu   fail %10llu\n",
            stats.nactive, stats.ntotal, stats.nfail);
-    printf("alloc size:  active %10llu   total %10llu   fail %10llu\n",
+    fprintf(f, "alloc size:  active %10llu   total %10llu   fail %10llu\n",
            stats.active_size, stats.total_size, stats.fail_size);
 }
 
 
-/// m61_print_leak_report()
+/// m61_print_detailed_statistics(f)
+///    Print the current memory statistics to `f`, then fragmentation and a
+///    histogram of allocations by size class. Internal fragmentation is
+///    the share of granted bytes not requested (size class rounding and
+///    canaries); external fragmentation is the share of held free bytes
+///    outside the largest free block.
+
+void m61_print_detailed_statistics(FILE* f) {
+    m61_print_statistics(f);
+    m61_statistics stats;
+    m61_get_statistics(&stats);
+
+    fprintf(f, "peak active size: %llu\n", stats.peak_active_size);
+    double internal = stats.granted_size > stats.active_size
+        ? 100.0 * (stats.granted_size - stats.active_size) / stats.granted_size : 0;
+    fprintf(f, "granted size: %llu (internal fragmentation %.1f%%)\n",
+           stats.granted_size, internal);
+    double external = stats.free_size > stats.largest_free_block
+        ? 100.0 * (stats.free_size - stats.largest_free_block) / stats.free_size : 0;
+    fprintf(f, "free size: %llu, largest free block %llu (external fragmentation %.1f%%)\n",
+           stats.free_size, stats.largest_free_block, external);
+
+    fprintf(f, "%23s %12s %12s\n", "size class", "active", "total");
+    for (int sc = 0; sc != M61_NSIZECLASSES; ++sc) {
+        if (stats.ntotal_by_class[sc] == 0) {
+            continue;
+        }
+        unsigned long long hi = sc == 64 ? ULLONG_MAX : 1ULL << sc;
+        unsigned long long lo = sc == 0 ? 0 : (hi >> 1) + 1;
+        fprintf(f, "%11llu-%-11llu %12llu %12llu\n", lo, hi,
+               stats.nactive_by_class[sc], stats.ntotal_by_class[sc]);
+    }
+}
+
+
+/// m61_print_leak_report(f)
 ///    Print a report of all currently-active allocated blocks of dynamic
-///    memory.
+///    memory to `f`.
+
+void m61_print_leak_report(FILE* f) {
+    if constexpr (!m61_config::leak_tracking) {
+        return;
+    }
+    for (auto& ts : block_table) {
+        std::lock_guard<m61_mutex> guard(ts.lock);
+        m61_for_each_active(ts, [f] (const m61_block& b) {
+            fprintf(f, "LEAK CHECK: %s: allocated object %p with size %zu\n",
+                   m61_site(b.file, b.line).s, reinterpret_cast<void*>(b.addr), b.size);
+        });
+    }
+    for (size_t pi = 0; pi != M61_POOL_NPOOLS; ++pi) {
+        std::lock_guard<m61_mutex> guard(pools[pi].lock);
+        for (m61_pool_slab* sl = pools[pi].slabs; sl; sl = sl->next) {
+            for (size_t i = 0; i != m61_pool_slab_slots(pi); ++i) {
+                m61_pool_slot* slot = m61_pool_slab_slot(sl, pi, i);
+                if (slot->file) {
+                    m61_site_key site = m61_pool_site(slot);
+                    fprintf(f, "LEAK CHECK: %s: allocated object %p with size %u\n",
+                           m61_site(site.file, site.line).s, static_cast<void*>(slot + 1),
+                           slot->size);
+                }
+            }
+        }
+    }
+    std::lock_guard<m61_mutex> guard(arena_lock);
+    for (m61_arena* a = live_arenas; a; a = a->next_live) {
+        fprintf(f, "LEAK CHECK: %s: allocated arena %p with %llu objects of total size %llu\n",
+               m61_site(a->file, a->line).s, static_cast<void*>(a), a->nalloc, a->size);
+    }
+}
+
+
+/// m61_write_leak_report(fd)
+///    Write a report of all currently-active allocated blocks of dynamic
+///    memory to file descriptor `fd`. Safe to call from a signal handler:
+///    it formats into a stack buffer, writes with write(2), and claims
+///    each table with a lock-free atomic (see `m61_mutex`) rather than
+///    its mutex. A table busy at the time (for instance, locked by the
+///    interrupted thread) is reported as skipped.
+
+void m61_write_leak_report(int fd) {
+    if constexpr (!m61_config::leak_tracking) {
+        return;
+    }
+    // the interrupted code may be about to read `errno`
+    int saved_errno = errno;
+    char buf[2048];
+    m61_printer pr(buf, sizeof(buf));
+    unsigned long long nskipped = 0;
+    for (auto& ts : block_table) {
+        if (!ts.lock.try_claim()) {
+            ++nskipped;
+            continue;
+        }
+        m61_for_each_active(ts, [&] (const m61_block& b) {
+            pr << "LEAK CHECK: ";
+            m61_write_site(pr, b.file, b.line);
+            pr << ": allocated object ";
+            pr.hex(b.addr) << " with size "
+                           << static_cast<unsigned long long>(b.size) << '\n';
+            pr.flush(fd);
+        });
+        ts.lock.release_claim();
+    }
+    for (size_t pi = 0; pi != M61_POOL_NPOOLS; ++pi) {
+        if (!pools[pi].lock.try_claim()) {
+            ++nskipped;
+            continue;
+        }
+        for (m61_pool_slab* sl = pools[pi].slabs; sl; sl = sl->next) {
+            for (size_t i = 0; i != m61_pool_slab_slots(pi); ++i) {
+                m61_pool_slot* slot = m61_pool_slab_slot(sl, pi, i);
+                if (slot->file) {
+                    pr << "LEAK CHECK: ";
+                    m61_site_key site = m61_pool_site(slot);
+                    m61_write_site(pr, site.file, site.line);
+                    pr << ": allocated object ";
+                    pr.hex(reinterpret_cast<uintptr_t>(slot + 1)) << " with size "
+                        << static_cast<unsigned long long>(slot->size) << '\n';
+                    pr.flush(fd);
+                }
+            }
+        }
+        pools[pi].lock.release_claim();
+    }
+    if (arena_lock.try_claim()) {
+        for (m61_arena* a = live_arenas; a; a = a->next_live) {
+            pr << "LEAK CHECK: ";
+            m61_write_site(pr, a->file, a->line);
+            pr << ": allocated arena ";
+            pr.hex(reinterpret_cast<uintptr_t>(a)) << " with " << a->nalloc
+                << " objects of total size " << a->size << '\n';
+            pr.flush(fd);
+        }
+        arena_lock.release_claim();
+    } else {
+        ++nskipped;
+    }
+    if (nskipped) {
+        pr << "LEAK CHECK: " << nskipped << " busy tables skipped\n";
+        pr.flush(fd);
+    }
+    errno = saved_errno;
+}
+
+
+/// m61_snapshot()
+///    Return a marker for the current point in the heap's history. Blocks
+///    allocated after this call can be reported by m61_print_leak_diff.
+
+unsigned long long m61_snapshot() {
+    return generation.fetch_add(1) + 1;
+}
+
 
-void m61_print_leak_report() {
-    // Your code here.
+/// m61_print_leak_diff(snapshot, f)
+///    Print to `f` the blocks allocated since `snapshot` that are still active,
+///    aggregated by allocation site, largest total first. Shards are
+///    scanned one at a time, so allocation elsewhere is never stopped; a
+///    block allocated or freed during the scan may or may not be counted.
+
+struct m61_leak_site {
+    const char* file;
+    long line;
+    unsigned long long count;
+    unsigned long long size;
+};
+
+void m61_print_leak_diff(unsigned long long snapshot, FILE* f) {
+    if constexpr (!m61_config::leak_tracking) {
+        return;
+    }
+    // live blocks are summed by site id, then sites the registry could
+    // not hold are appended
+    std::vector<m61_leak_site> sites(M61_SITE_NIDS, m61_leak_site{});
+    auto add = [&] (const char* file, long line, unsigned long long count,
+                    unsigned long long size) {
+        if (uint32_t id = m61_site_id(file, line)) {
+            sites[id].file = file;
+            sites[id].line = line;
+            sites[id].count += count;
+            sites[id].size += size;
+        } else {
+            sites.push_back({file, line, count, size});
+        }
+    };
+    for (auto& ts : block_table) {
+        std::lock_guard<m61_mutex> guard(ts.lock);
+        m61_for_each_active(ts, [&] (const m61_block& b) {
+            if (b.generation >= snapshot) {
+                add(b.file, b.line, 1, b.size);
+            }
+        });
+    }
+    for (size_t pi = 0; pi != M61_POOL_NPOOLS; ++pi) {
+        std::lock_guard<m61_mutex> guard(pools[pi].lock);
+        for (m61_pool_slab* sl = pools[pi].slabs; sl; sl = sl->next) {
+            for (size_t i = 0; i != m61_pool_slab_slots(pi); ++i) {
+                m61_pool_slot* slot = m61_pool_slab_slot(sl, pi, i);
+                // generations compare modulo 2^32
+                if (slot->file
+                    && int32_t(slot->generation - uint32_t(snapshot)) >= 0) {
+                    m61_site_key site = m61_pool_site(slot);
+                    add(site.file, site.line, 1, slot->size);
+                }
+            }
+        }
+    }
+    {
+        std::lock_guard<m61_mutex> guard(arena_lock);
+        for (m61_arena* a = live_arenas; a; a = a->next_live) {
+            if (a->generation >= snapshot) {
+                add(a->file, a->line, a->nalloc, a->size);
+            }
+        }
+    }
+
+    sites.erase(std::remove_if(sites.begin(), sites.end(),
+                               [] (const m61_leak_site& s) {
+                                   return !s.file;
+                               }),
+                sites.end());
+
+    // merge sites whose file names are equal but at different addresses
+    std::sort(sites.begin(), sites.end(), [] (const m61_leak_site& a,
+                                              const m61_leak_site& b) {
+        int cmp = strcmp(a.file, b.file);
+        return cmp < 0 || (cmp == 0 && a.line < b.line);
+    });
+    size_t n = 0;
+    for (size_t i = 0; i != sites.size(); ++i) {
+        if (n != 0
+            && sites[n - 1].line == sites[i].line
+            && strcmp(sites[n - 1].file, sites[i].file) == 0) {
+            sites[n - 1].count += sites[i].count;
+            sites[n - 1].size += sites[i].size;
+        } else {
+            sites[n] = sites[i];
+            ++n;
+        }
+    }
+    sites.resize(n);
+    std::stable_sort(sites.begin(), sites.end(), [] (const m61_leak_site& a,
+                                                     const m61_leak_site& b) {
+        return a.size > b.size;
+    });
+    for (auto& s : sites) {
+        fprintf(f, "LEAK DIFF: %s: %llu objects with total size %llu\n",
+               m61_site(s.file, s.line).s, s.count, s.size);
+    }
+}
+
+
+/// m61_print_lifetime_report(f)
+///    Print to `f` the lifetime profile of the busiest allocation sites: a log2
+///    histogram of cycles from allocation to free, and the share of frees
+///    in LIFO order. Sites whose blocks are short-lived and freed in LIFO
+///    order are flagged as arena candidates; sites whose blocks are
+///    long-lived and all one size are flagged as pool candidates.
+
+#define M61_LIFE_NREPORT        10      // # sites reported
+#define M61_LIFE_SHORT          16      // arena: median lifetime < 2^16 cycles
+#define M61_LIFE_LIFO           0.75    //   and at least 75% LIFO frees
+#define M61_LIFE_LONG           24      // pool: median lifetime >= 2^24 cycles
+
+void m61_print_lifetime_report(FILE* f) {
+    std::vector<m61_life_site> sites;
+    for (m61_stats_shard* s = stats_shards.load(std::memory_order_acquire);
+         s; s = s->next) {
+        m61_life_table* lt = s->life.load(std::memory_order_acquire);
+        if (!lt) {
+            continue;
+        }
+        while (s->life_lock.test_and_set(std::memory_order_acquire)) {
+        }
+        for (auto& ls : lt->sites) {
+            if (ls.file) {
+                sites.push_back(ls);
+            }
+        }
+        s->life_lock.clear(std::memory_order_release);
+    }
+
+    // merge sites from different threads
+    std::sort(sites.begin(), sites.end(), [] (const m61_life_site& a,
+                                              const m61_life_site& b) {
+        int cmp = strcmp(a.file, b.file);
+        return cmp < 0 || (cmp == 0 && a.line < b.line);
+    });
+    size_t n = 0;
+    for (size_t i = 0; i != sites.size(); ++i) {
+        m61_life_site& ls = sites[i];
+        if (n != 0
+            && sites[n - 1].line == ls.line
+            && strcmp(sites[n - 1].file, ls.file) == 0) {
+            m61_life_site& into = sites[n - 1];
+            into.nalloc += ls.nalloc;
+            into.nfree += ls.nfree;
+            into.nlifo += ls.nlifo;
+            into.min_size = std::min(into.min_size, ls.min_size);
+            into.max_size = std::max(into.max_size, ls.max_size);
+            for (int b = 0; b != M61_LIFE_NBUCKETS; ++b) {
+                into.hist[b] += ls.hist[b];
+            }
+        } else {
+            sites[n] = ls;
+            ++n;
+        }
+    }
+    sites.resize(n);
+    std::stable_sort(sites.begin(), sites.end(), [] (const m61_life_site& a,
+                                                     const m61_life_site& b) {
+        return a.nalloc > b.nalloc;
+    });
+    if (sites.size() > M61_LIFE_NREPORT) {
+        sites.resize(M61_LIFE_NREPORT);
+    }
+
+    for (auto& ls : sites) {
+        int median = 0;
+        for (unsigned long long seen = 0; median != M61_LIFE_NBUCKETS; ++median) {
+            seen += ls.hist[median];
+            if (2 * seen >= ls.nfree) {
+                break;
+            }
+        }
+        double lifo = ls.nfree ? double(ls.nlifo) / ls.nfree : 0;
+        fprintf(f, "LIFETIME: %s: %llu allocations, %llu frees, size %zu-%zu, %.0f%% LIFO",
+               m61_site(ls.file, ls.line).s, ls.nalloc, ls.nfree, ls.min_size, ls.max_size,
+               100 * lifo);
+        if (ls.nfree != 0) {
+            fprintf(f, ", median 2^%d cycles", median);
+            if (median < M61_LIFE_SHORT && lifo >= M61_LIFE_LIFO) {
+                fprintf(f, " (arena candidate)");
+            } else if (median >= M61_LIFE_LONG && ls.min_size == ls.max_size) {
+                fprintf(f, " (pool candidate)");
+            }
+        }
+        fprintf(f, "\n ");
+        for (int b = 0; b != M61_LIFE_NBUCKETS; ++b) {
+            if (ls.hist[b]) {
+                fprintf(f, " 2^%d:%llu", b, ls.hist[b]);
+            }
+        }
+        fprintf(f, "\n");
+    }
 }
 
 
-/// m61_print_heavy_hitter_report()
-///    Print a report of heavily-used allocation locations.
+/// m61_print_heavy_hitter_report(f)
+///    Print a report of heavily-used allocation locations to `f`.
+///    Each thread's per-site counts and Space-Saving tables are merged
+///    by site; a site is reported if it accounts for at least
+///    `M61_HH_THRESHOLD` of all bytes or of all allocations.
+
+#define M61_HH_THRESHOLD    0.1
+
+using m61_site_column = std::atomic<unsigned long long>[M61_SITE_NIDS];
+
+static void m61_print_heavy_hitters(m61_site_column m61_site_counts::* column,
+                                    m61_hh_table m61_stats_shard::* table,
+                                    const char* unit, FILE* f) {
+    std::vector<unsigned long long> by_id(M61_SITE_NIDS, 0);
+    std::vector<m61_hh_counter> cs;
+    unsigned long long total = 0;
+    for (m61_stats_shard* s = stats_shards.load(std::memory_order_acquire);
+         s; s = s->next) {
+        if (m61_site_counts* sc = s->sites.load(std::memory_order_acquire)) {
+            const m61_site_column& col = sc->*column;
+            for (size_t id = 1; id != M61_SITE_NIDS; ++id) {
+                unsigned long long w = col[id].load(std::memory_order_relaxed);
+                by_id[id] += w;
+                total += w;
+            }
+        }
+        while (s->hh_lock.test_and_set(std::memory_order_acquire)) {
+        }
+        const m61_hh_table& t = s->*table;
+        cs.insert(cs.end(), t.c, t.c + t.n);
+        total += t.total;
+        s->hh_lock.clear(std::memory_order_release);
+    }
+    if (total == 0) {
+        return;
+    }
+    size_t nids = std::min(site_nids.load(std::memory_order_acquire),
+                           uint32_t(M61_SITE_NIDS));
+    for (size_t id = 1; id != nids; ++id) {
+        if (by_id[id] != 0) {
+            cs.push_back({site_keys[id].file, site_keys[id].line, by_id[id], 0});
+        }
+    }
+
+    // merge counters for the same site from different threads, and
+    // sites whose file names are equal but at different addresses
+    std::sort(cs.begin(), cs.end(), [] (const m61_hh_counter& a,
+                                        const m61_hh_counter& b) {
+        int cmp = strcmp(a.file, b.file);
+        return cmp < 0 || (cmp == 0 && a.line < b.line);
+    });
+    size_t n = 0;
+    for (size_t i = 0; i != cs.size(); ++i) {
+        if (n != 0
+            && cs[n - 1].line == cs[i].line
+            && strcmp(cs[n - 1].file, cs[i].file) == 0) {
+            cs[n - 1].weight += cs[i].weight;
+            cs[n - 1].error += cs[i].error;
+        } else {
+            cs[n] = cs[i];
+            ++n;
+        }
+    }
+    cs.resize(n);
+
+    std::sort(cs.begin(), cs.end(), [] (const m61_hh_counter& a,
+                                        const m61_hh_counter& b) {
+        return a.weight > b.weight;
+    });
+    for (auto& c : cs) {
+        if (c.weight < total * M61_HH_THRESHOLD) {
+            break;
+        }
+        fprintf(f, "HEAVY HITTER: %s: %llu %s (~%.1f%%)\n",
+               m61_site(c.file, c.line).s, c.weight, unit, c.weight * 100.0 / total);
+    }
+}
 
-void m61_print_heavy_hitter_report() {
-    // Your heavy-hitters code here
+void m61_print_heavy_hitter_report(FILE* f) {
+    m61_print_heavy_hitters(&m61_site_counts::size, &m61_stats_shard::hh_size,
+                            "bytes", f);
+    m61_print_heavy_hitters(&m61_site_counts::count, &m61_stats_shard::hh_count,
+                            "allocations", f);
 }
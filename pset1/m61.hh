@@ -21,9 +21,35 @@ void m61_free(void* ptr, const char* file, long line);
 ///    should be initialized to zero.
 void* m61_calloc(size_t nmemb, size_t sz, const char* file, long line);
 
+/// m61_free_sized(ptr, sz, file, line)
+///    Free `ptr`, which was allocated with size `sz`.
+void m61_free_sized(void* ptr, size_t sz, const char* file, long line);
+
+/// m61_malloc_batch(n, sz, ptrs, file, line)
+///    Allocate `n` blocks of `sz` bytes into `ptrs`, recording them all at
+///    once. Returns the number allocated; unallocated entries are NULL.
+size_t m61_malloc_batch(size_t n, size_t sz, void** ptrs,
+                        const char* file, long line);
+
+/// m61_free_batch(ptrs, n, file, line)
+///    Free the `n` blocks in `ptrs` at once. May reorder `ptrs`.
+void m61_free_batch(void** ptrs, size_t n, const char* file, long line);
+
+/// m61_realloc(ptr, sz, file, line)
+///    Change the size of the block at `ptr` to `sz` bytes, moving it only
+///    if it cannot grow in place. Returns the block's new address.
+void* m61_realloc(void* ptr, size_t sz, const char* file, long line);
+
+/// m61_aligned_alloc(align, sz, file, line)
+///    Return a pointer to `sz` bytes of newly-allocated dynamic memory
+///    aligned to `align`, a power of 2 no larger than the page size.
+void* m61_aligned_alloc(size_t align, size_t sz, const char* file, long line);
+
 
 /// m61_statistics
 ///    Structure tracking memory statistics.
+#define M61_NSIZECLASSES    65          // # histogram size classes
+
 struct m61_statistics {
     unsigned long long nactive;         // # active allocations
     unsigned long long active_size;     // # bytes in active allocations
@@ -33,29 +59,224 @@ struct m61_statistics {
     unsigned long long fail_size;       // # bytes in failed alloc attempts
     uintptr_t heap_min;                 // smallest allocated addr
     uintptr_t heap_max;                 // largest allocated addr
+    unsigned long long nreuse;          // # base allocations that reused a freed block
+    unsigned long long nfresh;          // # base allocations that needed new memory
+    unsigned long long virtual_size;    // # bytes of address space held by base
+    unsigned long long resident_size;   // # of those bytes backed by memory
+    unsigned long long peak_active_size;    // largest `active_size` seen
+    unsigned long long granted_size;    // # bytes of base blocks in use
+    unsigned long long free_size;       // # bytes in freed small blocks held for reuse
+    unsigned long long largest_free_block;  // # bytes in the largest of those
+    // Histogram by power-of-two size class: class 0 holds sizes 0 and 1,
+    // class k holds sizes in (2^(k-1), 2^k].
+    unsigned long long nactive_by_class[M61_NSIZECLASSES];
+    unsigned long long ntotal_by_class[M61_NSIZECLASSES];
 };
 
 /// m61_get_statistics(stats)
 ///    Store the current memory statistics in `*stats`.
 void m61_get_statistics(m61_statistics* stats);
 
-/// m61_print_statistics()
-///    Print the current memory statistics.
-void m61_print_statistics();
+/// m61_print_statistics(f)
+///    Print the current memory statistics to `f`.
+void m61_print_statistics(FILE* f = stdout);
+
+/// m61_print_detailed_statistics(f)
+///    Print the current memory statistics, fragmentation, and a histogram
+///    of allocations by size class to `f`.
+void m61_print_detailed_statistics(FILE* f = stdout);
 
-/// m61_print_leak_report()
+/// m61_print_leak_report(f)
 ///    Print a report of all currently-active allocated blocks of dynamic
-///    memory.
-void m61_print_leak_report();
+///    memory to `f`.
+void m61_print_leak_report(FILE* f = stdout);
+
+/// m61_write_leak_report(fd)
+///    Like m61_print_leak_report, but write to file descriptor `fd`
+///    without allocating or waiting for a lock, so it is safe in a signal
+///    handler.
+void m61_write_leak_report(int fd);
+
+/// m61_snapshot()
+///    Return a marker for the current point in the heap's history.
+unsigned long long m61_snapshot();
+
+/// m61_print_leak_diff(snapshot, f)
+///    Print to `f` the blocks allocated since `snapshot` that are still
+///    active, aggregated by allocation site.
+void m61_print_leak_diff(unsigned long long snapshot, FILE* f = stdout);
+
+/// m61_print_heavy_hitter_report(f)
+///    Print a report of heavily-used allocation locations to `f`.
+void m61_print_heavy_hitter_report(FILE* f = stdout);
+
+/// m61_pool_alloc(sz, file, line)
+///    Return a pointer to one `sz`-byte object from a slab pool, for
+///    `sz <= M61_POOL_MAXSIZE`. Cheaper than m61_malloc for small objects.
+#define M61_POOL_MAXSIZE 256
+void* m61_pool_alloc(size_t sz, const char* file, long line);
+
+/// m61_pool_free(ptr, sz, file, line)
+///    Free `ptr`, which was returned by m61_pool_alloc with the same `sz`.
+void m61_pool_free(void* ptr, size_t sz, const char* file, long line);
+
+/// m61_arena
+///    A region of objects that are all freed together. An arena is not
+///    locked: one arena must not be used by two threads at once, though
+///    different arenas may be.
+struct m61_arena;
+
+/// m61_arena_create(file, line)
+///    Return a new, empty arena created at location `file`:`line`.
+m61_arena* m61_arena_create(const char* file, long line);
+
+/// m61_arena_alloc(arena, sz)
+///    Return a pointer to `sz` bytes of memory from `arena`. There is no
+///    per-object free; the memory lives until the arena is destroyed.
+///    Objects count toward the arena's creation site in heavy-hitter
+///    reports.
+void* m61_arena_alloc(m61_arena* arena, size_t sz);
+
+/// m61_arena_destroy(arena)
+///    Free every object allocated from `arena`, and the arena itself.
+void m61_arena_destroy(m61_arena* arena);
+
+/// m61_set_quarantine_size(bytes)
+///    Hold up to `bytes` bytes of freed blocks per thread, poisoned, and
+///    check them for writes before reuse. 0 disables the quarantine.
+void m61_set_quarantine_size(size_t bytes);
+
+/// m61_print_lifetime_report(f)
+///    Print to `f` how long blocks from the busiest allocation sites live,
+///    and flag sites that look suited to an arena or a pool.
+void m61_print_lifetime_report(FILE* f = stdout);
+
+/// m61_set_stack_depth(depth, rate)
+///    Attribute one in every `rate` allocations to its call stack, up to
+///    `depth` frames (at most 16), instead of to its immediate site. The
+///    stack is found by following frame pointers, so callers should be
+///    compiled with -fno-omit-frame-pointer. 0 disables capture.
+void m61_set_stack_depth(unsigned depth, unsigned long rate = 1);
+
+/// m61_set_guard_sampling(rate)
+///    Place one in every `rate` allocations on a guard page, so that
+///    overflows and uses after free fault immediately. 0 disables sampling.
+void m61_set_guard_sampling(unsigned long rate);
+
+/// m61_trim()
+///    Give every free page of small blocks back to the OS now, rather than
+///    waiting for the next lazy pass, which a thread runs after every
+///    16384 frees. Returns the number of bytes released.
+size_t m61_trim();
+
+/// libm61.so (m61preload.cc) runs unmodified programs under m61. It
+/// records allocation sites by return address: `file` is
+/// `m61_retaddr_file` and `line` is the address. Reports symbolize them.
+extern const char m61_retaddr_file[];
+
+/// m61_owns(ptr)
+///    Return true if `ptr` points into m61's heap, whether or not it is an
+///    active block.
+bool m61_owns(void* ptr);
+
+/// m61_usable_size(ptr)
+///    Return the size of active block `ptr`, or 0 if it is not one.
+size_t m61_usable_size(void* ptr);
+
+#if M61_PRELOAD
+/// In libm61.so, the system allocator behind m61.
+void* m61_real_malloc(size_t sz);
+void* m61_real_calloc(size_t nmemb, size_t sz);
+void m61_real_free(void* ptr);
+int m61_real_posix_memalign(void** pptr, size_t align, size_t sz);
+#endif
+
+/// m61_trace_open(filename, nrecords)
+///    Start recording allocation events into `filename`, a memory-mapped
+///    ring holding `nrecords` records. Returns false on error.
+bool m61_trace_open(const char* filename, size_t nrecords);
+
+/// m61_trace_close()
+///    Stop recording and unmap the trace file. No other thread may
+///    allocate concurrently.
+void m61_trace_close();
+
+/// Trace file format: an `m61_trace_header` followed by `capacity`
+/// `m61_trace_record`s. Record `i` is stored at index `i % capacity`, so
+/// once `nwritten > capacity` the ring holds the last `capacity` events.
+#define M61_TRACE_MAGIC "M61TRACE"
+
+struct m61_trace_header {
+    char magic[8];                      // M61_TRACE_MAGIC, without '\0'
+    uint64_t capacity;                  // # records in the ring
+    uint64_t nwritten;                  // # records ever written
+    uint64_t reserved;
+};
+
+enum m61_trace_op {
+    m61_trace_malloc = 1, m61_trace_free = 2, m61_trace_calloc = 3
+};
+
+struct m61_trace_record {
+    uint64_t tsc;                       // timestamp counter at the event
+    uint64_t size;                      // bytes requested; 0 for free
+    uint64_t id;                        // allocation id, unique in a trace
+    uint32_t site;                      // allocation or free site id
+    uint32_t op;                        // an `m61_trace_op`
+};
+
+
+/// m61_policy<features, guard_sampling>
+///    Compile-time selection of m61's checking features. m61.cc is built
+///    with the policy named by the `M61_POLICY` macro (default
+///    `m61_debug_policy`); code for a disabled feature is compiled out.
+///    `guard_sampling` is the initial rate for m61_set_guard_sampling.
+enum m61_feature : unsigned {
+    m61_feature_statistics = 1,         // m61_get_statistics counters
+    m61_feature_heavy_hitters = 2,      // heavy-hitter report
+    m61_feature_canaries = 4,           // boundary canaries checked at free
+    m61_feature_wild_free = 8,          // invalid and double free reports
+    m61_feature_leak_tracking = 16,     // leak report
+    m61_feature_lifetimes = 32,         // lifetime report
+    m61_feature_quarantine = 64,        // poisoned quarantine of freed blocks
+    m61_feature_stacks = 128,           // call-stack attribution
+    m61_all_features = 255
+};
+
+template <unsigned Features, unsigned long GuardSampling = 0>
+struct m61_policy {
+    static constexpr bool statistics = Features & m61_feature_statistics;
+    static constexpr bool heavy_hitters = Features & m61_feature_heavy_hitters;
+    static constexpr bool canaries = Features & m61_feature_canaries;
+    static constexpr bool wild_free = Features & m61_feature_wild_free;
+    static constexpr bool leak_tracking = Features & m61_feature_leak_tracking;
+    static constexpr bool lifetimes = Features & m61_feature_lifetimes;
+    static constexpr bool quarantine = Features & m61_feature_quarantine;
+    static constexpr bool stacks = Features & m61_feature_stacks;
+    static constexpr unsigned long guard_sampling = GuardSampling;
+};
+
+using m61_prod_policy = m61_policy<m61_feature_statistics>;
+using m61_debug_policy = m61_policy<m61_all_features>;
+using m61_paranoid_policy = m61_policy<m61_all_features, 16>;
 
-/// m61_print_heavy_hitter_report()
-///    Print a report of heavily-used allocation locations.
-void m61_print_heavy_hitter_report();
 
 /// `m61.cc` should use these functions rather than malloc() and free().
 void* base_malloc(size_t sz);
+void* base_calloc(size_t sz);
 void base_free(void* ptr);
+size_t base_free_size(void* ptr);       // returns the size `ptr` was allocated with
+void* base_aligned_malloc(size_t align, size_t sz);
+bool base_resize(void* ptr, size_t sz, size_t* oldsz);  // true if resized in place
+bool base_lookup(void* ptr, size_t* sz);    // true if `ptr` is active
+enum base_heap_class { base_not_in_heap, base_in_heap, base_block_start };
+base_heap_class base_classify(void* ptr);   // constant time; takes no lock
+size_t base_trim();                     // returns # bytes given back to the OS
+void base_fork_prepare();               // pthread_atfork hooks
+void base_fork_parent();
+void base_fork_child();
 void base_allocator_disable(bool is_disabled);
+void base_allocator_statistics(m61_statistics* stats);
 
 
 /// Override system versions with our versions.
@@ -63,24 +284,64 @@ void base_allocator_disable(bool is_disabled);
 #define malloc(sz)          m61_malloc((sz), __FILE__, __LINE__)
 #define free(ptr)           m61_free((ptr), __FILE__, __LINE__)
 #define calloc(nmemb, sz)   m61_calloc((nmemb), (sz), __FILE__, __LINE__)
+#define realloc(ptr, sz)    m61_realloc((ptr), (sz), __FILE__, __LINE__)
+#define aligned_alloc(align, sz) m61_aligned_alloc((align), (sz), __FILE__, __LINE__)
 #endif
 
 
 /// This magic class lets standard C++ containers use your debugging allocator,
-/// instead of the system allocator.
+/// instead of the system allocator. Allocations are attributed to the place
+/// the allocator was constructed (pass one explicitly to a container to
+/// name your own code). Single small objects, such as list and map nodes,
+/// come from slab pools.
 template <typename T>
 class m61_allocator {
 public:
     using value_type = T;
-    m61_allocator() noexcept = default;
+    m61_allocator(const char* file = __builtin_FILE(),
+                  long line = __builtin_LINE()) noexcept
+        : file_(file), line_(line) {
+    }
     m61_allocator(const m61_allocator<T>&) noexcept = default;
-    template <typename U> m61_allocator(m61_allocator<U>&) noexcept {}
+    template <typename U> m61_allocator(const m61_allocator<U>& x) noexcept
+        : file_(x.file()), line_(x.line()) {
+    }
 
     T* allocate(size_t n) {
-        return reinterpret_cast<T*>(m61_malloc(n * sizeof(T), "?", 0));
+        if (n > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* ptr;
+        if (pooled(n)) {
+            ptr = m61_pool_alloc(sizeof(T), file_, line_);
+        } else {
+            ptr = m61_malloc(n * sizeof(T), file_, line_);
+        }
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return reinterpret_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, size_t n) {
+        if (pooled(n)) {
+            m61_pool_free(ptr, sizeof(T), file_, line_);
+        } else {
+            m61_free_sized(ptr, n * sizeof(T), file_, line_);
+        }
+    }
+    const char* file() const noexcept {
+        return file_;
+    }
+    long line() const noexcept {
+        return line_;
     }
-    void deallocate(T* ptr, size_t) {
-        m61_free(ptr, "?", 0);
+
+private:
+    const char* file_;
+    long line_;
+
+    static constexpr bool pooled(size_t n) {
+        return n == 1 && sizeof(T) <= M61_POOL_MAXSIZE && alignof(T) <= 16;
     }
 };
 template <typename T, typename U>
@@ -92,4 +353,48 @@ inline constexpr bool operator!=(const m61_allocator<T>&, const m61_allocator<U>
     return false;
 }
 
+
+/// This class lets standard C++ containers allocate from an m61 arena.
+/// Deallocation does nothing; memory is reclaimed when the arena is
+/// destroyed, which must happen after every container using it is gone.
+template <typename T>
+class m61_arena_allocator {
+public:
+    using value_type = T;
+    explicit m61_arena_allocator(m61_arena* arena) noexcept
+        : arena_(arena) {
+    }
+    m61_arena_allocator(const m61_arena_allocator<T>&) noexcept = default;
+    template <typename U> m61_arena_allocator(const m61_arena_allocator<U>& x) noexcept
+        : arena_(x.arena()) {
+    }
+
+    T* allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        T* ptr = reinterpret_cast<T*>(m61_arena_alloc(arena_, n * sizeof(T)));
+        if (!ptr) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+    void deallocate(T*, size_t) {
+    }
+    m61_arena* arena() const noexcept {
+        return arena_;
+    }
+
+private:
+    m61_arena* arena_;
+};
+template <typename T, typename U>
+inline bool operator==(const m61_arena_allocator<T>& a, const m61_arena_allocator<U>& b) {
+    return a.arena() == b.arena();
+}
+template <typename T, typename U>
+inline bool operator!=(const m61_arena_allocator<T>& a, const m61_arena_allocator<U>& b) {
+    return a.arena() != b.arena();
+}
+
 #endif
@@ -0,0 +1,307 @@
+#include "m61.hh"
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "m61bench.hh"
+#define NALLOCATORS 40
+// m61bench: Measure m61 throughput, latency, and memory use, with
+// machine-readable output for tracking regressions across builds.
+
+void* ptr = nullptr;
+
+// the hhtest allocation functions
+#include "hhtest-tinyalloc.cc"
+#include "hhtest-smallalloc.cc"
+#include "hhtest-largealloc.cc"
+
+void (*allocators[])() = {
+    &tiny1, &tiny2, &tiny3, &tiny4, &tiny5,
+    &tiny6, &tiny7, &tiny8, &tiny9, &tiny10,
+    &tiny11, &tiny12, &tiny13, &tiny14, &tiny15,
+    &tiny16, &tiny17, &tiny18, &tiny19, &tiny20,
+    &small1, &small2, &small3, &small4, &small5,
+    &small6, &small7, &small8, &small9, &small10,
+    &medium1, &medium2, &medium3, &medium4, &medium5,
+    &large1, &large2, &large3, &large4, &large5
+};
+
+
+// Results of one phase: per-operation latencies in cycles, plus RSS
+// sampled every `rss_interval` operations. The latency array is touched
+// before the phase starts so it does not show up in the RSS samples.
+struct bench_result {
+    const char* name;
+    std::vector<uint32_t> latency;
+    size_t n = 0;
+    std::vector<std::pair<size_t, size_t>> rss;
+    double seconds = 0;
+
+    static constexpr size_t rss_interval = 1 << 16;
+
+    bench_result(const char* name_, size_t capacity)
+        : name(name_), latency(capacity) {
+    }
+    void record(uint64_t t0, uint64_t t1) {
+        if (n != latency.size()) {
+            latency[n] = std::min(t1 - t0, uint64_t(UINT32_MAX));
+            ++n;
+        }
+        if (n % rss_interval == 0) {
+            rss.emplace_back(n, rss_anon_kb());
+        }
+    }
+    void merge(const bench_result& r) {
+        std::copy(r.latency.begin(), r.latency.begin() + r.n, latency.begin() + n);
+        n += r.n;
+        rss.insert(rss.end(), r.rss.begin(), r.rss.end());
+    }
+};
+
+// Timer for one phase. Cycle counts are converted to nanoseconds using
+// the TSC rate measured over the phase.
+struct bench_timer {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t tsc_start = bench_cycles();
+
+    void stop(bench_result& r, double& ns_per_cycle) {
+        uint64_t tsc_end = bench_cycles();
+        std::chrono::duration<double> delta = std::chrono::steady_clock::now() - start;
+        r.seconds = delta.count();
+        ns_per_cycle = r.seconds * 1e9 / std::max(tsc_end - tsc_start, uint64_t(1));
+    }
+};
+
+
+// Call `count` random allocators in [lo, hi), with the skewed distribution
+// used by hhtest: allocator `lo + I` is chosen with probability
+// proportional to 2^(-I*skew).
+static void phase(bench_result& r, int lo, int hi,
+                  double skew, unsigned long long count) {
+    double sum_p = 0;
+    for (int i = lo; i < hi; ++i) {
+        sum_p += pow(0.5, (i - lo) * skew);
+    }
+    long limit[NALLOCATORS];
+    double ppos = 0;
+    for (int i = lo; i < hi; ++i) {
+        ppos += pow(0.5, (i - lo) * skew);
+        limit[i] = RAND_MAX * (ppos / sum_p);
+    }
+
+    for (unsigned long long i = 0; i < count; ++i) {
+        long x = random();
+        int a = lo;
+        while (a < hi - 1 && x > limit[a]) {
+            ++a;
+        }
+        uint64_t t0 = bench_cycles();
+        allocators[a]();
+        r.record(t0, bench_cycles());
+    }
+    free(ptr);
+    ptr = nullptr;
+}
+
+
+// Producer/consumer: `nproducers` threads allocate blocks and hand them
+// to one consumer thread, which frees them, so every free is remote.
+struct handoff_queue {
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<void*> items;
+    unsigned nproducers;
+};
+
+static void producer(handoff_queue& q, bench_result& r,
+                     unsigned long long count, unsigned seed) {
+    std::vector<void*> batch;
+    for (unsigned long long i = 0; i != count; ++i) {
+        seed = seed * 1103515245U + 12345U;
+        uint64_t t0 = bench_cycles();
+        void* p = malloc(1 + (seed >> 16) % 512);
+        r.record(t0, bench_cycles());
+        batch.push_back(p);
+        if (batch.size() == 64 || i + 1 == count) {
+            std::unique_lock<std::mutex> guard(q.m);
+            q.items.insert(q.items.end(), batch.begin(), batch.end());
+            q.cv.notify_one();
+            batch.clear();
+        }
+    }
+    std::unique_lock<std::mutex> guard(q.m);
+    --q.nproducers;
+    q.cv.notify_one();
+}
+
+static void consumer(handoff_queue& q, bench_result& r) {
+    std::vector<void*> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(q.m);
+            q.cv.wait(guard, [&] { return !q.items.empty() || q.nproducers == 0; });
+            if (q.items.empty()) {
+                return;
+            }
+            batch.swap(q.items);
+        }
+        for (void* p : batch) {
+            uint64_t t0 = bench_cycles();
+            free(p);
+            r.record(t0, bench_cycles());
+        }
+        batch.clear();
+    }
+}
+
+static void cross_thread(bench_result& r, unsigned nproducers,
+                         unsigned long long count) {
+    handoff_queue q;
+    q.nproducers = nproducers;
+    std::vector<bench_result> results;
+    for (unsigned t = 0; t != nproducers; ++t) {
+        results.emplace_back(r.name, count / nproducers);
+    }
+    results.emplace_back(r.name, count);
+    std::vector<std::thread> th;
+    for (unsigned t = 0; t != nproducers; ++t) {
+        th.emplace_back(producer, std::ref(q), std::ref(results[t]),
+                        count / nproducers, t + 1);
+    }
+    th.emplace_back(consumer, std::ref(q), std::ref(results[nproducers]));
+    for (auto& t : th) {
+        t.join();
+    }
+    for (auto& res : results) {
+        r.merge(res);
+    }
+}
+
+
+// Realloc churn: blocks repeatedly grow and shrink through realloc.
+static void realloc_churn(bench_result& r, unsigned long long count) {
+    void* slots[64] = {};
+    size_t sizes[64] = {};
+    unsigned seed = 1;
+    for (unsigned long long i = 0; i != count; ++i) {
+        seed = seed * 1103515245U + 12345U;
+        unsigned s = (seed >> 8) % 64;
+        // mostly grow by up to 50%, sometimes shrink back to small
+        size_t newsz = (seed >> 16) % 8 == 0 || sizes[s] > 65536
+            ? 1 + (seed >> 20) % 64
+            : sizes[s] + 1 + sizes[s] / 2;
+        uint64_t t0 = bench_cycles();
+        slots[s] = realloc(slots[s], newsz);
+        r.record(t0, bench_cycles());
+        sizes[s] = newsz;
+    }
+    for (void* p : slots) {
+        free(p);
+    }
+}
+
+
+static void print_result(bench_result& r, double ns_per_cycle, bool last) {
+    size_t n = r.n;
+    printf("    {\"name\": \"%s\", \"ops\": %zu, \"seconds\": %.6f, "
+           "\"ops_per_sec\": %.0f,\n", r.name, n, r.seconds,
+           r.seconds > 0 ? n / r.seconds : 0.0);
+    printf("     \"latency_ns\": {");
+    const char* sep = "";
+    for (auto pct : {std::make_pair("p50", 50.0), std::make_pair("p99", 99.0),
+                     std::make_pair("p999", 99.9)}) {
+        uint32_t cycles = 0;
+        if (n != 0) {
+            size_t k = std::min(n - 1, size_t(n * pct.second / 100));
+            std::nth_element(r.latency.begin(), r.latency.begin() + k,
+                             r.latency.begin() + n);
+            cycles = r.latency[k];
+        }
+        printf("%s\"%s\": %.1f", sep, pct.first, cycles * ns_per_cycle);
+        sep = ", ";
+    }
+    printf("},\n     \"rss_kb\": [");
+    sep = "";
+    std::sort(r.rss.begin(), r.rss.end());
+    for (auto& s : r.rss) {
+        printf("%s[%zu, %zu]", sep, s.first, s.second);
+        sep = ", ";
+    }
+    printf("]}%s\n", last ? "" : ",");
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0
+                     || strcmp(argv[1], "--help") == 0)) {
+        printf("Usage: ./m61bench [COUNT [SKEW [THREADS]]]\n\
+\n\
+  Runs COUNT operations in each benchmark phase and prints the results as\n\
+  JSON: ops/sec, p50/p99/p999 latency, and anonymous RSS sampled over the\n\
+  phase. The tiny, small, medium, and large phases call the hhtest\n\
+  allocation functions with skew SKEW (default 0). The cross_thread phase\n\
+  frees blocks allocated by THREADS producer threads (default 2) on a\n\
+  consumer thread. The realloc_churn phase repeatedly resizes blocks.\n\
+  The default COUNT is 1000000.\n");
+        exit(0);
+    }
+
+    unsigned long long count = 1000000;
+    if (argc > 1) {
+        count = strtoull(argv[1], nullptr, 0);
+    }
+    double skew = 0;
+    if (argc > 2) {
+        skew = strtod(argv[2], nullptr);
+    }
+    unsigned nproducers = 2;
+    if (argc > 3) {
+        nproducers = std::max(1UL, strtoul(argv[3], nullptr, 0));
+    }
+
+    struct {
+        const char* name;
+        int lo, hi;
+    } distributions[] = {
+        {"tiny", 0, 20}, {"small", 20, 30}, {"medium", 30, 35}, {"large", 35, 40}
+    };
+
+    printf("{\"benchmark\": \"m61bench\", \"count\": %llu, \"skew\": %g, "
+           "\"threads\": %u,\n \"phases\": [\n", count, skew, nproducers);
+    double ns_per_cycle;
+    for (auto& d : distributions) {
+        bench_result r(d.name, count);
+        bench_timer t;
+        phase(r, d.lo, d.hi, skew, count);
+        t.stop(r, ns_per_cycle);
+        print_result(r, ns_per_cycle, false);
+    }
+    {
+        bench_result r("cross_thread", 2 * count);
+        bench_timer t;
+        cross_thread(r, nproducers, count);
+        t.stop(r, ns_per_cycle);
+        print_result(r, ns_per_cycle, false);
+    }
+    {
+        bench_result r("realloc_churn", count);
+        bench_timer t;
+        realloc_churn(r, count);
+        t.stop(r, ns_per_cycle);
+        print_result(r, ns_per_cycle, true);
+    }
+
+    m61_statistics stats;
+    m61_get_statistics(&stats);
+    printf(" ],\n \"statistics\": {\"nactive\": %llu, \"ntotal\": %llu, "
+           "\"nfail\": %llu, \"total_size\": %llu, \"nreuse\": %llu, "
+           "\"nfresh\": %llu,\n                \"virtual_size\": %llu, "
+           "\"resident_size\": %llu}\n}\n", stats.nactive, stats.ntotal,
+           stats.nfail, stats.total_size, stats.nreuse, stats.nfresh,
+           stats.virtual_size, stats.resident_size);
+}
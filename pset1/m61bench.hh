@@ -0,0 +1,40 @@
+#ifndef M61BENCH_HH
+#define M61BENCH_HH 1
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+// Measurement helpers shared by m61bench, m61replay, and tests.
+
+// bench_cycles()
+//    Return the timestamp counter, or, where there is none, a nanosecond
+//    clock. Callers convert using the rate measured over their run.
+inline uint64_t bench_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// rss_anon_kb()
+//    Return anonymous resident memory in KiB, from /proc/self/status.
+inline size_t rss_anon_kb() {
+    FILE* f = fopen("/proc/self/status", "r");
+    size_t kb = 0;
+    char line[256];
+    while (f && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "RssAnon: %zu kB", &kb) == 1) {
+            break;
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+    return kb;
+}
+
+#endif
@@ -0,0 +1,438 @@
+#define M61_DISABLE 1
+#include "m61.hh"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <atomic>
+#include <new>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// m61preload: libm61.so, which runs an unmodified program under m61:
+//
+//     LD_PRELOAD=./libm61.so M61_REPORT=leaks ./program
+//
+// The library exports malloc and its relatives and the C++ operator new
+// and delete family, and attributes each allocation to its caller's
+// return address. At exit it prints the reports named in `M61_REPORT`, a
+// comma-separated list of `statistics`, `leaks`, `heavy_hitters` and
+// `lifetimes` (default `statistics,heavy_hitters`), on standard error.
+//
+// The system allocator is found with dlsym, which itself allocates; until
+// it is found, requests are served from a static bootstrap buffer that is
+// never freed. While a thread is inside m61, its allocations (m61's own
+// tables, and anything the C library allocates for it) bypass m61 and go
+// straight to the system allocator. Memory m61 does not own, such as
+// that, is freed by the system allocator.
+
+
+// The system allocator
+
+struct m61_real_allocator {
+    void* (*malloc)(size_t);
+    void* (*calloc)(size_t, size_t);
+    void* (*realloc)(void*, size_t);
+    void (*free)(void*);
+    int (*posix_memalign)(void**, size_t, size_t);
+    size_t (*malloc_usable_size)(void*);
+};
+
+static m61_real_allocator real;
+static std::atomic<int> real_state;     // 0 unresolved, 1 resolving, 2 ready
+static int report_fd = -1;              // copy of stderr, for reports
+
+// depth of m61 calls on this thread
+static __thread int busy __attribute__((tls_model("initial-exec")));
+
+struct m61_busy_scope {
+    m61_busy_scope() {
+        ++busy;
+    }
+    ~m61_busy_scope() {
+        --busy;
+    }
+};
+
+
+// Bootstrap buffer: a bump allocator for requests made before the system
+// allocator is found. Each block is preceded by its size.
+
+#define M61_BOOTSTRAP_SIZE  (64 << 10)
+
+alignas(4096) static char bootstrap[M61_BOOTSTRAP_SIZE];
+static std::atomic<size_t> bootstrap_used;
+
+static void* m61_bootstrap_alloc(size_t align, size_t sz) {
+    align = align < 16 ? 16 : align;
+    size_t pos = bootstrap_used.load(std::memory_order_relaxed), start;
+    do {
+        start = (pos + 16 + align - 1) & ~(align - 1);
+        if (sz > M61_BOOTSTRAP_SIZE || start > M61_BOOTSTRAP_SIZE - sz) {
+            return nullptr;
+        }
+    } while (!bootstrap_used.compare_exchange_weak(pos, start + sz));
+    memcpy(&bootstrap[start - sizeof(size_t)], &sz, sizeof(size_t));
+    return &bootstrap[start];
+}
+
+static inline bool m61_bootstrap_contains(void* ptr) {
+    return ptr >= bootstrap && ptr < bootstrap + M61_BOOTSTRAP_SIZE;
+}
+
+static size_t m61_bootstrap_size(void* ptr) {
+    size_t sz;
+    memcpy(&sz, static_cast<char*>(ptr) - sizeof(size_t), sizeof(size_t));
+    return sz;
+}
+
+
+// m61_preload_ready()
+//    Return true once the system allocator is resolved, resolving it on
+//    the first call. Requests made during resolution, by dlsym on this
+//    thread or by other threads, see false.
+
+static bool m61_preload_ready() {
+    int state = real_state.load(std::memory_order_acquire);
+    if (state == 2) {
+        return true;
+    } else if (state == 1
+               || !real_state.compare_exchange_strong(state, 1)) {
+        return false;
+    }
+    m61_busy_scope scope;
+    real.malloc = reinterpret_cast<void* (*)(size_t)>(dlsym(RTLD_NEXT, "malloc"));
+    real.calloc = reinterpret_cast<void* (*)(size_t, size_t)>(dlsym(RTLD_NEXT, "calloc"));
+    real.realloc = reinterpret_cast<void* (*)(void*, size_t)>(dlsym(RTLD_NEXT, "realloc"));
+    real.free = reinterpret_cast<void (*)(void*)>(dlsym(RTLD_NEXT, "free"));
+    real.posix_memalign = reinterpret_cast<int (*)(void**, size_t, size_t)>(
+        dlsym(RTLD_NEXT, "posix_memalign"));
+    real.malloc_usable_size = reinterpret_cast<size_t (*)(void*)>(
+        dlsym(RTLD_NEXT, "malloc_usable_size"));
+    if (!real.malloc || !real.calloc || !real.realloc || !real.free
+        || !real.posix_memalign || !real.malloc_usable_size) {
+        static const char msg[] = "libm61.so: cannot find the system allocator\n";
+        ssize_t w = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        (void) w;
+        abort();
+    }
+    // programs may close stderr before exit
+    report_fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
+    real_state.store(2, std::memory_order_release);
+    return true;
+}
+
+// true if this request should go to m61 rather than the system allocator
+static inline bool m61_preload_use_m61() {
+    return !busy && m61_preload_ready();
+}
+
+static inline bool m61_real_ready() {
+    return real_state.load(std::memory_order_acquire) == 2;
+}
+
+void* m61_real_malloc(size_t sz) {
+    return m61_real_ready() ? real.malloc(sz) : m61_bootstrap_alloc(16, sz);
+}
+
+void* m61_real_calloc(size_t nmemb, size_t sz) {
+    if (m61_real_ready()) {
+        return real.calloc(nmemb, sz);
+    } else if (sz != 0 && nmemb > SIZE_MAX / sz) {
+        return nullptr;
+    }
+    // the bootstrap buffer is never reused, so it is still zero
+    return m61_bootstrap_alloc(16, nmemb * sz);
+}
+
+void m61_real_free(void* ptr) {
+    if (ptr && !m61_bootstrap_contains(ptr) && m61_real_ready()) {
+        real.free(ptr);
+    }
+}
+
+int m61_real_posix_memalign(void** pptr, size_t align, size_t sz) {
+    if (m61_real_ready()) {
+        return real.posix_memalign(pptr, align, sz);
+    }
+    *pptr = m61_bootstrap_alloc(align, sz);
+    return *pptr ? 0 : ENOMEM;
+}
+
+
+// Allocation entry points. Each exported function passes its return
+// address as the allocation site.
+
+#define M61_CALLER  reinterpret_cast<long>(__builtin_return_address(0))
+
+static void* m61_preload_malloc(size_t sz, long caller) {
+    if (!m61_preload_use_m61()) {
+        return m61_real_malloc(sz);
+    }
+    m61_busy_scope scope;
+    return m61_malloc(sz, m61_retaddr_file, caller);
+}
+
+static void* m61_preload_calloc(size_t nmemb, size_t sz, long caller) {
+    if (!m61_preload_use_m61()) {
+        return m61_real_calloc(nmemb, sz);
+    }
+    m61_busy_scope scope;
+    return m61_calloc(nmemb, sz, m61_retaddr_file, caller);
+}
+
+static void* m61_preload_aligned_alloc(size_t align, size_t sz, long caller) {
+    if (!m61_preload_use_m61()) {
+        void* ptr;
+        return m61_real_posix_memalign(&ptr, align, sz) == 0 ? ptr : nullptr;
+    }
+    m61_busy_scope scope;
+    return m61_aligned_alloc(align, sz, m61_retaddr_file, caller);
+}
+
+// m61_preload_free(ptr, sz, caller)
+//    Free `ptr`, whose size is `sz` if the caller knows it (sized delete)
+//    and SIZE_MAX otherwise.
+static void m61_preload_free(void* ptr, size_t sz, long caller) {
+    if (!ptr || m61_bootstrap_contains(ptr)) {
+        return;
+    } else if (!m61_preload_use_m61()) {
+        m61_real_free(ptr);
+        return;
+    }
+    m61_busy_scope scope;
+    if (!m61_owns(ptr)) {
+        real.free(ptr);
+    } else if (sz != SIZE_MAX) {
+        m61_free_sized(ptr, sz, m61_retaddr_file, caller);
+    } else {
+        m61_free(ptr, m61_retaddr_file, caller);
+    }
+}
+
+static void* m61_preload_realloc(void* ptr, size_t sz, long caller) {
+    if (m61_bootstrap_contains(ptr)) {
+        void* nptr = m61_preload_malloc(sz, caller);
+        if (nptr) {
+            size_t oldsz = m61_bootstrap_size(ptr);
+            memcpy(nptr, ptr, oldsz < sz ? oldsz : sz);
+        }
+        return nptr;
+    } else if (!m61_preload_use_m61()) {
+        return m61_real_ready() ? real.realloc(ptr, sz) : m61_real_malloc(sz);
+    }
+    m61_busy_scope scope;
+    if (ptr && !m61_owns(ptr)) {
+        return real.realloc(ptr, sz);
+    }
+    return m61_realloc(ptr, sz, m61_retaddr_file, caller);
+}
+
+
+extern "C" {
+
+void* malloc(size_t sz) {
+    return m61_preload_malloc(sz, M61_CALLER);
+}
+
+void* calloc(size_t nmemb, size_t sz) {
+    return m61_preload_calloc(nmemb, sz, M61_CALLER);
+}
+
+void* realloc(void* ptr, size_t sz) {
+    return m61_preload_realloc(ptr, sz, M61_CALLER);
+}
+
+void* reallocarray(void* ptr, size_t nmemb, size_t sz) {
+    if (sz != 0 && nmemb > SIZE_MAX / sz) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return m61_preload_realloc(ptr, nmemb * sz, M61_CALLER);
+}
+
+void free(void* ptr) {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+
+void* memalign(size_t align, size_t sz) {
+    return m61_preload_aligned_alloc(align, sz, M61_CALLER);
+}
+
+void* aligned_alloc(size_t align, size_t sz) {
+    return m61_preload_aligned_alloc(align, sz, M61_CALLER);
+}
+
+int posix_memalign(void** pptr, size_t align, size_t sz) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+    void* ptr = m61_preload_aligned_alloc(align, sz, M61_CALLER);
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *pptr = ptr;
+    return 0;
+}
+
+void* valloc(size_t sz) {
+    return m61_preload_aligned_alloc(sysconf(_SC_PAGESIZE), sz, M61_CALLER);
+}
+
+void* pvalloc(size_t sz) {
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    return m61_preload_aligned_alloc(pagesize, (sz + pagesize - 1) & ~(pagesize - 1),
+                                     M61_CALLER);
+}
+
+int malloc_trim(size_t) {
+    if (!m61_preload_use_m61()) {
+        return 0;
+    }
+    m61_busy_scope scope;
+    return m61_trim() != 0;
+}
+
+size_t malloc_usable_size(void* ptr) {
+    if (!ptr) {
+        return 0;
+    } else if (m61_bootstrap_contains(ptr)) {
+        return m61_bootstrap_size(ptr);
+    } else if (!m61_preload_use_m61()) {
+        return m61_real_ready() ? real.malloc_usable_size(ptr) : 0;
+    }
+    m61_busy_scope scope;
+    return m61_owns(ptr) ? m61_usable_size(ptr) : real.malloc_usable_size(ptr);
+}
+
+}
+
+
+// C++ allocation. Failed throwing allocations call the new handler, as
+// the standard operator new does.
+
+static void* m61_preload_new(size_t sz, size_t align, long caller) {
+    while (true) {
+        void* ptr = align > 16 ? m61_preload_aligned_alloc(align, sz, caller)
+            : m61_preload_malloc(sz, caller);
+        if (ptr) {
+            return ptr;
+        } else if (std::new_handler h = std::get_new_handler()) {
+            h();
+        } else {
+            throw std::bad_alloc();
+        }
+    }
+}
+
+static void* m61_preload_new_nothrow(size_t sz, size_t align, long caller) noexcept {
+    try {
+        return m61_preload_new(sz, align, caller);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new(size_t sz) {
+    return m61_preload_new(sz, 0, M61_CALLER);
+}
+void* operator new[](size_t sz) {
+    return m61_preload_new(sz, 0, M61_CALLER);
+}
+void* operator new(size_t sz, const std::nothrow_t&) noexcept {
+    return m61_preload_new_nothrow(sz, 0, M61_CALLER);
+}
+void* operator new[](size_t sz, const std::nothrow_t&) noexcept {
+    return m61_preload_new_nothrow(sz, 0, M61_CALLER);
+}
+void* operator new(size_t sz, std::align_val_t align) {
+    return m61_preload_new(sz, size_t(align), M61_CALLER);
+}
+void* operator new[](size_t sz, std::align_val_t align) {
+    return m61_preload_new(sz, size_t(align), M61_CALLER);
+}
+void* operator new(size_t sz, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return m61_preload_new_nothrow(sz, size_t(align), M61_CALLER);
+}
+void* operator new[](size_t sz, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return m61_preload_new_nothrow(sz, size_t(align), M61_CALLER);
+}
+
+void operator delete(void* ptr) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete[](void* ptr) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete(void* ptr, size_t sz) noexcept {
+    m61_preload_free(ptr, sz, M61_CALLER);
+}
+void operator delete[](void* ptr, size_t sz) noexcept {
+    m61_preload_free(ptr, sz, M61_CALLER);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete(void* ptr, size_t sz, std::align_val_t) noexcept {
+    m61_preload_free(ptr, sz, M61_CALLER);
+}
+void operator delete[](void* ptr, size_t sz, std::align_val_t) noexcept {
+    m61_preload_free(ptr, sz, M61_CALLER);
+}
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    m61_preload_free(ptr, SIZE_MAX, M61_CALLER);
+}
+
+
+// Reports at exit
+
+static bool m61_report_wanted(const char* list, const char* name) {
+    size_t n = strlen(name);
+    for (const char* s = list; (s = strstr(s, name)); s += n) {
+        if ((s == list || s[-1] == ',') && (s[n] == ',' || s[n] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+__attribute__((destructor)) static void m61_preload_report() {
+    if (!m61_real_ready()) {
+        return;
+    }
+    m61_busy_scope scope;
+    const char* list = getenv("M61_REPORT");
+    if (!list) {
+        list = "statistics,heavy_hitters";
+    }
+    FILE* f = report_fd >= 0 ? fdopen(report_fd, "w") : nullptr;
+    if (!f) {
+        return;
+    }
+    if (m61_report_wanted(list, "statistics")) {
+        m61_print_detailed_statistics(f);
+    }
+    if (m61_report_wanted(list, "leaks")) {
+        m61_print_leak_report(f);
+    }
+    if (m61_report_wanted(list, "heavy_hitters")) {
+        m61_print_heavy_hitter_report(f);
+    }
+    if (m61_report_wanted(list, "lifetimes")) {
+        m61_print_lifetime_report(f);
+    }
+    fclose(f);
+}
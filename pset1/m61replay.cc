@@ -0,0 +1,157 @@
+#define M61_DISABLE 1
+#include "m61.hh"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "m61bench.hh"
+// m61replay: Replay an m61 allocation trace against an allocator and
+// report throughput, latency percentiles, and peak memory use.
+
+struct replay_backend {
+    const char* name;
+    void* (*malloc)(size_t sz);
+    void* (*calloc)(size_t sz);
+    void (*free)(void* ptr);
+};
+
+static const replay_backend backends[] = {
+    {"system",
+     [] (size_t sz) { return ::malloc(sz); },
+     [] (size_t sz) { return ::calloc(1, sz); },
+     [] (void* ptr) { ::free(ptr); }},
+    {"base",
+     [] (size_t sz) { return base_malloc(sz); },
+     [] (size_t sz) {
+         void* ptr = base_malloc(sz);
+         return ptr ? memset(ptr, 0, sz) : ptr;
+     },
+     [] (void* ptr) { base_free(ptr); }},
+    {"m61",
+     [] (size_t sz) { return m61_malloc(sz, "m61replay", 0); },
+     [] (size_t sz) { return m61_calloc(1, sz, "m61replay", 0); },
+     [] (void* ptr) { m61_free(ptr, "m61replay", 0); }}
+};
+
+static void usage() {
+    fprintf(stderr, "Usage: ./m61replay [-b BACKEND] TRACEFILE\n\
+\n\
+  Replays the allocation events in TRACEFILE, which was written by\n\
+  m61_trace_open, against BACKEND: system (malloc/free), base\n\
+  (base_malloc/base_free), or m61 (m61_malloc/m61_free). The default is\n\
+  system.\n");
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    const replay_backend* be = &backends[0];
+    int opt;
+    while ((opt = getopt(argc, argv, "b:h")) != -1) {
+        if (opt != 'b') {
+            usage();
+        }
+        be = nullptr;
+        for (auto& b : backends) {
+            if (strcmp(b.name, optarg) == 0) {
+                be = &b;
+            }
+        }
+        if (!be) {
+            usage();
+        }
+    }
+    if (optind + 1 != argc) {
+        usage();
+    }
+
+    // map the trace
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(argv[optind]);
+        exit(1);
+    }
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const m61_trace_header* th = reinterpret_cast<const m61_trace_header*>(map);
+    if (map == MAP_FAILED
+        || size_t(st.st_size) < sizeof(*th)
+        || memcmp(th->magic, M61_TRACE_MAGIC, sizeof(th->magic)) != 0
+        || size_t(st.st_size) < sizeof(*th) + th->capacity * sizeof(m61_trace_record)) {
+        fprintf(stderr, "%s: not an m61 trace\n", argv[optind]);
+        exit(1);
+    }
+    close(fd);
+    const m61_trace_record* recs = reinterpret_cast<const m61_trace_record*>(th + 1);
+    uint64_t first = th->nwritten > th->capacity ? th->nwritten - th->capacity : 0;
+    size_t nevents = th->nwritten - first;
+
+    // allocation ids are dense, so live pointers live in a flat array
+    uint64_t minid = UINT64_MAX, maxid = 0;
+    for (uint64_t i = first; i != th->nwritten; ++i) {
+        const m61_trace_record& r = recs[i % th->capacity];
+        minid = std::min(minid, r.id);
+        maxid = std::max(maxid, r.id);
+    }
+    std::vector<void*> ptrs(nevents ? maxid - minid + 1 : 0, nullptr);
+    std::vector<uint32_t> latency;
+    latency.reserve(nevents);
+    size_t rss_base = rss_anon_kb() * 1024, rss_peak = rss_base;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t tsc_start = bench_cycles();
+    size_t nskipped = 0;
+    for (uint64_t i = first; i != th->nwritten; ++i) {
+        const m61_trace_record& r = recs[i % th->capacity];
+        void*& slot = ptrs[r.id - minid];
+        uint64_t t0 = bench_cycles();
+        if (r.op == m61_trace_free) {
+            if (!slot) {
+                // its allocation was overwritten in the ring
+                ++nskipped;
+                continue;
+            }
+            be->free(slot);
+            slot = nullptr;
+        } else if (r.op == m61_trace_calloc) {
+            slot = be->calloc(r.size);
+        } else {
+            slot = be->malloc(r.size);
+        }
+        uint64_t t1 = bench_cycles();
+        latency.push_back(std::min(t1 - t0, uint64_t(UINT32_MAX)));
+        if (latency.size() % 65536 == 0) {
+            rss_peak = std::max(rss_peak, rss_anon_kb() * 1024);
+        }
+    }
+    uint64_t tsc_end = bench_cycles();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    rss_peak = std::max(rss_peak, rss_anon_kb() * 1024);
+    for (void* ptr : ptrs) {
+        if (ptr) {
+            be->free(ptr);
+        }
+    }
+
+    // report; cycle counts are converted using the TSC rate over the run
+    double ns_per_cycle = elapsed.count() * 1e9 / (tsc_end - tsc_start);
+    size_t n = latency.size();
+    printf("backend:    %s\n", be->name);
+    printf("events:     %zu replayed, %zu skipped\n", n, nskipped);
+    printf("throughput: %.0f ops/sec\n", n / elapsed.count());
+    for (double pct : {50.0, 99.0, 99.9}) {
+        if (n == 0) {
+            break;
+        }
+        size_t k = std::min(n - 1, size_t(n * pct / 100));
+        std::nth_element(latency.begin(), latency.begin() + k, latency.end());
+        printf("p%-4g       %u cycles (%.0f ns)\n", pct, latency[k],
+               latency[k] * ns_per_cycle);
+    }
+    printf("peak RSS:   %zu KiB above baseline\n", (rss_peak - rss_base) / 1024);
+}
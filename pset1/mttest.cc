@@ -0,0 +1,65 @@
+#include "m61.hh"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+// mttest: Measure m61 throughput as the number of threads grows.
+
+static void work(unsigned long long count, unsigned seed) {
+    void* slots[256] = {};
+    for (unsigned long long i = 0; i != count; ++i) {
+        seed = seed * 1103515245U + 12345U;
+        unsigned slot = (seed >> 8) % 256;
+        free(slots[slot]);
+        slots[slot] = malloc(1 + (seed >> 16) % 256);
+    }
+    for (auto p : slots) {
+        free(p);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0
+                     || strcmp(argv[1], "--help") == 0)) {
+        printf("Usage: ./mttest [MAXTHREADS [COUNT]]\n\
+\n\
+  Runs COUNT malloc/free pairs in each of 1, 2, 4, ... MAXTHREADS threads\n\
+  and reports total throughput. The default MAXTHREADS is the number of\n\
+  cores; the default COUNT is 1000000.\n");
+        exit(0);
+    }
+
+    unsigned maxthreads = std::thread::hardware_concurrency();
+    if (argc > 1) {
+        maxthreads = strtoul(argv[1], nullptr, 0);
+    }
+    unsigned long long count = 1000000;
+    if (argc > 2) {
+        count = strtoull(argv[2], nullptr, 0);
+    }
+
+    double base_rate = 0;
+    for (unsigned n = 1; n <= maxthreads; n *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        std::thread* th = new std::thread[n];
+        for (unsigned t = 0; t != n; ++t) {
+            th[t] = std::thread(work, count, t + 1);
+        }
+        for (unsigned t = 0; t != n; ++t) {
+            th[t].join();
+        }
+        delete[] th;
+        std::chrono::duration<double> delta = std::chrono::steady_clock::now() - start;
+        double rate = n * count / delta.count();
+        if (n == 1) {
+            base_rate = rate;
+        }
+        printf("%3u threads: %12.0f ops/sec  (%.2fx)\n", n, rate, rate / base_rate);
+    }
+
+    m61_statistics stats;
+    m61_get_statistics(&stats);
+    printf("reuse: %llu of %llu base allocations\n",
+           stats.nreuse, stats.nreuse + stats.nfresh);
+}
@@ -0,0 +1,38 @@
+#include "m61.hh"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+// policybench: Measure the per-operation cost of an m61 policy build.
+// `make policybench` builds and runs one copy per policy.
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0
+                     || strcmp(argv[1], "--help") == 0)) {
+        printf("Usage: ./policybench-POLICY [NAME [COUNT]]\n\
+\n\
+  Runs COUNT malloc/free pairs (default 10000000) of 1 to 256 bytes and\n\
+  reports the average cost of one pair, labeled NAME.\n");
+        exit(0);
+    }
+    const char* name = argc > 1 ? argv[1] : "m61";
+    unsigned long long count = 10000000;
+    if (argc > 2) {
+        count = strtoull(argv[2], nullptr, 0);
+    }
+
+    void* slots[256] = {};
+    unsigned seed = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long long i = 0; i != count; ++i) {
+        seed = seed * 1103515245U + 12345U;
+        unsigned slot = (seed >> 8) % 256;
+        free(slots[slot]);
+        slots[slot] = malloc(1 + (seed >> 16) % 256);
+    }
+    std::chrono::duration<double> delta = std::chrono::steady_clock::now() - start;
+    for (auto p : slots) {
+        free(p);
+    }
+    printf("%-28s %8.1f ns per malloc/free pair\n", name, delta.count() * 1e9 / count);
+}
@@ -0,0 +1,44 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <thread>
+// Allocations from several threads, including frees of blocks allocated
+// by a different thread, are all counted.
+
+void* ptrs[4][1000];
+
+void work(int t) {
+    for (int round = 0; round != 100; ++round) {
+        for (int i = 0; i != 1000; ++i) {
+            ptrs[t][i] = malloc(i % 100 + 1);
+        }
+        if (round != 99) {
+            for (int i = 0; i != 1000; ++i) {
+                free(ptrs[t][i]);
+            }
+        }
+    }
+}
+
+int main() {
+    std::thread th[4];
+    for (int t = 0; t != 4; ++t) {
+        th[t] = std::thread(work, t);
+    }
+    for (int t = 0; t != 4; ++t) {
+        th[t].join();
+    }
+    m61_print_statistics();
+    // free the last round from the main thread
+    for (int t = 0; t != 4; ++t) {
+        for (int i = 0; i != 1000; ++i) {
+            free(ptrs[t][i]);
+        }
+    }
+    m61_print_statistics();
+}
+
+//! alloc count: active       4000   total     400000   fail          0
+//! alloc size:  active     202000   total   20200000   fail          0
+//! alloc count: active          0   total     400000   fail          0
+//! alloc size:  active          0   total   20200000   fail          0
@@ -0,0 +1,22 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Heavy hitters stand out among many more allocation sites than the
+// tracker has counters.
+
+int main() {
+    for (int i = 0; i != 400000; ++i) {
+        void* ptr;
+        if (i % 4 == 0) {
+            ptr = m61_malloc(100, "heavy.cc", 1);
+        } else {
+            ptr = m61_malloc(1 + random() % 10, "light.cc", 1 + random() % 20000);
+        }
+        m61_free(ptr, "light.cc", 0);
+    }
+    m61_print_heavy_hitter_report();
+}
+
+//! HEAVY HITTER: heavy.cc:1: 10000000 bytes (~??{8\d\.\d}??%)
+//! HEAVY HITTER: heavy.cc:1: 100000 allocations (~25.0%)
@@ -0,0 +1,24 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Wild free inside one of many active blocks reports the right block.
+
+int main() {
+    char* ptrs[1000];
+    for (int i = 0; i != 1000; ++i) {
+        ptrs[i] = (char*) malloc(1 + random() % 500);
+    }
+    char* big = (char*) malloc(3000);
+    for (int i = 0; i != 1000; i += 2) {
+        free(ptrs[i]);
+    }
+    fprintf(stderr, "Bad pointer %p\n", big + 1000);
+    free(big + 1000);
+    m61_print_statistics();
+}
+
+//! Bad pointer ??{0x\w+}=ptr??
+//! MEMORY BUG: test043.cc:17: invalid free of pointer ??ptr??, not allocated
+//!   test043.cc:12: ??ptr?? is 1000 bytes inside a 3000 byte region allocated here
+//! ???
@@ -0,0 +1,19 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Guard-page sampling catches a buffer overflow at the faulting write.
+
+int main() {
+    m61_set_guard_sampling(1);
+    char* ptr = (char*) malloc(32);
+    fprintf(stderr, "Will overflow %p\n", ptr);
+    for (int i = 0; i <= 32 /* Whoops! Should be < */; ++i) {
+        ptr[i] = 'A';
+    }
+    fprintf(stderr, "Not reached\n");
+}
+
+//! Will overflow ??{0x\w+}=ptr??
+//! MEMORY BUG: wild access to pointer ???, heap buffer overflow
+//!   test044.cc:9: ??? is 0 bytes past the end of a 32 byte region allocated here
@@ -0,0 +1,19 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Guard-page sampling catches a use after free at the faulting read.
+
+int main() {
+    m61_set_guard_sampling(1);
+    int* ptr = (int*) malloc(10 * sizeof(int));
+    for (int i = 0; i != 10; ++i) {
+        ptr[i] = i;
+    }
+    free(ptr);
+    fprintf(stderr, "Value %d\n", ptr[3]);
+}
+
+//! MEMORY BUG: wild access to pointer ???, use after free
+//!   test045.cc:9: ??? is 12 bytes inside a 40 byte region allocated here
+//!   test045.cc:13: region freed here
@@ -0,0 +1,55 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/mman.h>
+// Allocation trace records events into a ring that keeps the latest ones.
+
+int main() {
+    char name[] = "/tmp/m61trace.XXXXXX";
+    int fd = mkstemp(name);
+    assert(fd >= 0);
+    close(fd);
+    bool ok = m61_trace_open(name, 8);
+    assert(ok);
+
+    void* ptrs[5];
+    for (int i = 0; i != 5; ++i) {
+        ptrs[i] = malloc(10 * (i + 1));
+    }
+    void* z = calloc(3, 4);
+    for (int i = 0; i != 5; ++i) {
+        free(ptrs[i]);
+    }
+    free(z);
+    m61_trace_close();
+
+    FILE* f = fopen(name, "r");
+    assert(f);
+    m61_trace_header th;
+    size_t n = fread(&th, sizeof(th), 1, f);
+    assert(n == 1);
+    assert(memcmp(th.magic, M61_TRACE_MAGIC, 8) == 0);
+    printf("capacity %zu, written %zu\n", size_t(th.capacity), size_t(th.nwritten));
+    m61_trace_record recs[8];
+    n = fread(recs, sizeof(m61_trace_record), 8, f);
+    assert(n == 8);
+    for (uint64_t i = th.nwritten - th.capacity; i != th.nwritten; ++i) {
+        const m61_trace_record& r = recs[i % th.capacity];
+        printf("op %u size %zu\n", r.op, size_t(r.size));
+    }
+    fclose(f);
+    unlink(name);
+}
+
+//! capacity 8, written 12
+//! op 1 size 50
+//! op 3 size 12
+//! op 2 size 0
+//! op 2 size 0
+//! op 2 size 0
+//! op 2 size 0
+//! op 2 size 0
+//! op 2 size 0
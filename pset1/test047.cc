@@ -0,0 +1,46 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Large blocks are mapped directly, and freeing them returns memory.
+
+int main() {
+    m61_statistics before, during, after;
+    m61_get_statistics(&before);
+
+    char* ptrs[64];
+    for (int i = 0; i != 64; ++i) {
+        ptrs[i] = (char*) malloc(1 << 20);
+        assert(ptrs[i]);
+        memset(ptrs[i], i, 1 << 20);
+    }
+    m61_get_statistics(&during);
+    printf("resident grew by at least 64 MiB: %s\n",
+           during.resident_size - before.resident_size >= (64ULL << 20) ? "yes" : "no");
+
+    for (int i = 0; i != 64; ++i) {
+        free(ptrs[i]);
+    }
+    m61_get_statistics(&after);
+    // all but the quarantined blocks have been released
+    printf("resident shrank by at least 32 MiB: %s\n",
+           during.resident_size - after.resident_size >= (32ULL << 20) ? "yes" : "no");
+    printf("virtual at least resident: %s\n",
+           after.virtual_size >= after.resident_size ? "yes" : "no");
+
+    // reallocating reuses released mappings, which read as zero
+    char* p = (char*) malloc(1 << 20);
+    assert(p);
+    m61_statistics again;
+    m61_get_statistics(&again);
+    printf("reused a mapping: %s\n", again.nreuse > after.nreuse ? "yes" : "no");
+    free(p);
+    m61_print_statistics();
+}
+
+//! resident grew by at least 64 MiB: yes
+//! resident shrank by at least 32 MiB: yes
+//! virtual at least resident: yes
+//! reused a mapping: yes
+//! alloc count: active          0   total         65   fail          0
+//! alloc size:  active          0   total   68157440   fail          0
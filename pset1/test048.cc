@@ -0,0 +1,51 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include "m61bench.hh"
+// Large calloc does not touch memory that is already zero.
+
+int main() {
+    size_t before = rss_anon_kb();
+    char* big = (char*) calloc(64, 1 << 20);
+    assert(big);
+    printf("fresh calloc faulted in under 1 MiB: %s\n",
+           rss_anon_kb() - before < 1024 ? "yes" : "no");
+    free(big);
+
+    // dirty some blocks, then push them through quarantine
+    char* dirty[20];
+    for (int i = 0; i != 20; ++i) {
+        dirty[i] = (char*) malloc(100000);
+        memset(dirty[i], 0xFF, 100000);
+    }
+    for (int i = 0; i != 20; ++i) {
+        free(dirty[i]);
+    }
+    int nonzero = 0;
+    for (int i = 0; i != 20; ++i) {
+        unsigned char* p = (unsigned char*) calloc(1000, 100);
+        for (int j = 0; j != 100000; ++j) {
+            nonzero += p[j] != 0;
+        }
+        free(p);
+    }
+    printf("nonzero bytes: %d\n", nonzero);
+
+    // small calloc of reused memory is still cleared
+    char* small = (char*) malloc(100);
+    memset(small, 0xFF, 100);
+    free(small);
+    for (int i = 0; i != 100; ++i) {
+        unsigned char* p = (unsigned char*) calloc(10, 10);
+        for (int j = 0; j != 100; ++j) {
+            nonzero += p[j] != 0;
+        }
+        free(p);
+    }
+    printf("nonzero bytes: %d\n", nonzero);
+}
+
+//! fresh calloc faulted in under 1 MiB: yes
+//! nonzero bytes: 0
+//! nonzero bytes: 0
@@ -0,0 +1,51 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include <map>
+// Arena allocations count in statistics and are released in bulk.
+
+int main() {
+    m61_arena* a = m61_arena_create(__FILE__, __LINE__);
+    for (int i = 0; i != 10000; ++i) {
+        char* p = (char*) m61_arena_alloc(a, 10);
+        assert(p && ((uintptr_t) p & 15) == 0);
+        memset(p, i, 10);
+    }
+    char* big = (char*) m61_arena_alloc(a, 1 << 20);
+    assert(big);
+    memset(big, 0, 1 << 20);
+    m61_print_statistics();
+
+    // containers can allocate from an arena
+    m61_arena* b = m61_arena_create(__FILE__, __LINE__);
+    {
+        m61_arena_allocator<int> alloc(b);
+        std::vector<int, m61_arena_allocator<int>> v(alloc);
+        for (int i = 0; i != 1000; ++i) {
+            v.push_back(i);
+        }
+        std::map<int, int, std::less<int>,
+                 m61_arena_allocator<std::pair<const int, int>>> m(alloc);
+        for (int i = 0; i != 100; ++i) {
+            m[i] = v[i * 10];
+        }
+        assert(m[99] == 990);
+    }
+
+    m61_arena_destroy(a);
+    m61_print_statistics();
+    m61_print_leak_report();
+    m61_arena_destroy(b);
+    m61_print_leak_report();
+    m61_print_statistics();
+}
+
+//! alloc count: active      10001   total      10001   fail          0
+//! alloc size:  active    1148576   total    1148576   fail          0
+//! alloc count: active        ???   total        ???   fail          0
+//! alloc size:  active        ???   total        ???   fail          0
+//! LEAK CHECK: test049.cc:22: allocated arena ??{\w+}?? with ??{\d+}?? objects of total size ???
+//! alloc count: active          0   total        ???   fail          0
+//! alloc size:  active          0   total        ???   fail          0
@@ -0,0 +1,35 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <list>
+#include <map>
+// Container nodes come from slab pools, attributed to the allocator's site.
+
+int main() {
+    m61_allocator<int> alloc;
+    std::list<int, m61_allocator<int>>* l =
+        new std::list<int, m61_allocator<int>>(alloc);
+    for (int i = 0; i != 1000; ++i) {
+        l->push_back(i);
+    }
+    {
+        std::map<int, int, std::less<int>,
+                 m61_allocator<std::pair<const int, int>>> m(alloc);
+        for (int i = 0; i != 5000; ++i) {
+            m[i] = i;
+        }
+        assert(m.size() == 5000);
+    }
+    m61_print_statistics();
+    while (l->size() > 2) {
+        l->pop_front();
+    }
+    // leak the list's last two nodes
+    m61_print_leak_report();
+}
+
+//! alloc count: active       1000   total       6000   fail          0
+//! alloc size:  active      24000   total     224000   fail          0
+//!!UNORDERED
+//! LEAK CHECK: test050.cc:9: allocated object ??{\w+}?? with size 24
+//! LEAK CHECK: test050.cc:9: allocated object ??{\w+}?? with size 24
@@ -0,0 +1,37 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Size-class histogram, peak active size, and fragmentation statistics.
+
+int main() {
+    // Quarantined blocks are not free to the base allocator.
+    m61_set_quarantine_size(0);
+    void* ptrs[100];
+    for (int i = 0; i != 100; ++i) {
+        ptrs[i] = malloc(i < 60 ? 24 : 1000);
+    }
+    for (int i = 0; i != 100; i += 2) {
+        free(ptrs[i]);
+    }
+    void* more = malloc(3);
+
+    m61_statistics stat;
+    m61_get_statistics(&stat);
+    assert(stat.peak_active_size == 60 * 24 + 40 * 1000);
+    assert(stat.granted_size >= stat.active_size);
+    assert(stat.free_size >= stat.largest_free_block);
+    assert(stat.largest_free_block >= 1000);
+    m61_print_detailed_statistics();
+    free(more);
+}
+
+//! alloc count: active         51   total        101   fail          0
+//! alloc size:  active      20723   total      41443   fail          0
+//! peak active size: 41440
+//! granted size: ??{\d+}?? (internal fragmentation ??{[\d.]+}??%)
+//! free size: ??{\d+}??, largest free block ??{\d+}?? (external fragmentation ??{[\d.]+}??%)
+//!              size class       active        total
+//!           3-4                      1            1
+//!          17-32                    30           60
+//!         513-1024                  20           40
@@ -0,0 +1,33 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Leak diff reports only blocks allocated since the snapshot.
+
+int main() {
+    void* old1 = malloc(100);
+    void* old2 = malloc(200);
+    unsigned long long snap = m61_snapshot();
+
+    void* ptrs[10];
+    for (int i = 0; i != 10; ++i) {
+        ptrs[i] = malloc(50);
+    }
+    void* big = malloc(5000);
+    void* gone = malloc(70);
+    free(gone);
+    for (int i = 0; i != 4; ++i) {
+        free(ptrs[i]);
+    }
+    free(old1);
+    m61_print_leak_diff(snap);
+
+    unsigned long long snap2 = m61_snapshot();
+    printf("after second snapshot\n");
+    m61_print_leak_diff(snap2);
+    (void) old2, (void) big;
+}
+
+//! LEAK DIFF: test052.cc:16: 1 objects with total size 5000
+//! LEAK DIFF: test052.cc:14: 6 objects with total size 300
+//! after second snapshot
@@ -0,0 +1,34 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <unistd.h>
+// Lifetime report flags short-lived LIFO sites and long-lived uniform sites.
+
+void* scratch[20];
+void* keep[100];
+
+int main() {
+    // short-lived, freed in reverse order of allocation
+    for (int round = 0; round != 1000; ++round) {
+        for (int i = 0; i != 20; ++i) {
+            scratch[i] = malloc(8 + i);
+        }
+        for (int i = 19; i >= 0; --i) {
+            free(scratch[i]);
+        }
+    }
+    // long-lived, all one size
+    for (int i = 0; i != 100; ++i) {
+        keep[i] = malloc(64);
+    }
+    usleep(100000);
+    for (int i = 0; i != 100; ++i) {
+        free(keep[i]);
+    }
+    m61_print_lifetime_report();
+}
+
+//! LIFETIME: test053.cc:14: 20000 allocations, 20000 frees, size 8-27, 100% LIFO, median 2^??{\d+}?? cycles (arena candidate)
+//! ???
+//! LIFETIME: test053.cc:22: 100 allocations, 100 frees, size 64-64, ??{\d+}??% LIFO, median 2^??{\d+}?? cycles (pool candidate)
+//! ???
@@ -0,0 +1,19 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// A write after free is caught when the block leaves the quarantine.
+
+int main() {
+    m61_set_quarantine_size(4096);
+    char* p = (char*) malloc(100);
+    free(p);
+    p[40] = 'X';
+    for (int i = 0; i != 100; ++i) {
+        free(malloc(64));
+    }
+    printf("should not get here\n");
+}
+
+//! MEMORY BUG: test054.cc:10: write after free to pointer ??{0x\w+}??, 40 bytes inside a 100 byte region freed here
+//! ???
@@ -0,0 +1,49 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Realloc grows in place within size-class slack, moves otherwise, and
+// keeps statistics and the leak report up to date.
+
+int main() {
+    char* p = (char*) malloc(90);
+    memset(p, 'A', 90);
+    // 100 bytes still fit the block's size class
+    char* q = (char*) realloc(p, 100);
+    assert(q == p);
+    for (int i = 0; i != 90; ++i) {
+        assert(q[i] == 'A');
+    }
+
+    // much larger: must move, keeping the contents
+    char* r = (char*) realloc(q, 5000);
+    assert(r && r != q);
+    for (int i = 0; i != 90; ++i) {
+        assert(r[i] == 'A');
+    }
+    r[4999] = 'B';
+
+    // shrinking keeps the prefix
+    char* s = (char*) realloc(r, 50);
+    assert(s);
+    for (int i = 0; i != 50; ++i) {
+        assert(s[i] == 'A');
+    }
+
+    char* t = (char*) realloc(nullptr, 10);
+    assert(t);
+    free(t);
+
+    m61_statistics stat;
+    m61_get_statistics(&stat);
+    assert(stat.nactive == 1);
+    assert(stat.active_size == 50);
+    assert(stat.ntotal == 5);
+    assert(stat.total_size == 90 + 100 + 5000 + 50 + 10);
+
+    printf("EXPECTED LEAK: %p with size 50\n", s);
+    m61_print_leak_report();
+}
+
+//! EXPECTED LEAK: ??{0x\w*}=ptr?? with size 50
+//! LEAK CHECK: test???.cc:27: allocated object ??ptr?? with size 50
@@ -0,0 +1,46 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <cstdint>
+// Aligned allocations of all sizes, with statistics and failures.
+
+int main() {
+    static const size_t sizes[] = {1, 100, 20000};
+    void* ptrs[30];
+    int n = 0;
+    for (size_t align = 32; align <= 4096; align *= 2) {
+        for (size_t sz : sizes) {
+            void* p = aligned_alloc(align, sz);
+            assert(p);
+            assert(reinterpret_cast<uintptr_t>(p) % align == 0);
+            memset(p, 0, sz);
+            ptrs[n++] = p;
+        }
+    }
+    // reuse of freed blocks keeps the alignment
+    for (int i = 0; i != n; ++i) {
+        free(ptrs[i]);
+    }
+    for (int i = 0; i != 200; ++i) {
+        void* p = aligned_alloc(64, 48);
+        assert(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+        free(p);
+    }
+
+    // not a power of 2, or too large
+    assert(!aligned_alloc(48, 100));
+    assert(!aligned_alloc(1 << 20, 100));
+
+    void* leak = aligned_alloc(256, 77);
+    m61_statistics stat;
+    m61_get_statistics(&stat);
+    assert(stat.nactive == 1);
+    assert(stat.ntotal == 24 + 200 + 1);
+    assert(stat.nfail == 2);
+    printf("EXPECTED LEAK: %p with size 77\n", leak);
+    m61_print_leak_report();
+}
+
+//! EXPECTED LEAK: ??{0x\w*}=ptr?? with size 77
+//! LEAK CHECK: test???.cc:35: allocated object ??ptr?? with size 77
@@ -0,0 +1,15 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Boundary write past an aligned block, detected by realloc.
+
+int main() {
+    char* p = (char*) aligned_alloc(64, 100);
+    p[100] = 'X';
+    p = (char*) realloc(p, 200);
+    m61_print_statistics();
+}
+
+//! MEMORY BUG???: detected wild write during realloc of pointer ??{0x\w+}??
+//! ???
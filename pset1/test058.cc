@@ -0,0 +1,40 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Call-stack attribution separates callers of an allocation wrapper.
+
+__attribute__((noinline)) void* xmalloc(size_t sz) {
+    void* ptr = malloc(sz);
+    assert(ptr);
+    return ptr;
+}
+
+__attribute__((noinline)) void often() {
+    for (int i = 0; i != 800; ++i) {
+        free(xmalloc(64));
+    }
+}
+
+__attribute__((noinline)) void rarely() {
+    for (int i = 0; i != 200; ++i) {
+        free(xmalloc(64));
+    }
+}
+
+int main() {
+    m61_set_stack_depth(4);
+    often();
+    rarely();
+    void* leak = xmalloc(10);
+    printf("EXPECTED LEAK: %p\n", leak);
+    m61_print_heavy_hitter_report();
+    m61_print_leak_report();
+}
+
+//! EXPECTED LEAK: ??{0x\w+}=ptr??
+//! HEAVY HITTER: test058.cc:8 <- ??{[^:]+}??: 51200 bytes (~80.0%)
+//! HEAVY HITTER: test058.cc:8 <- ??{[^:]+}??: 12800 bytes (~20.0%)
+//! HEAVY HITTER: test058.cc:8 <- ??{[^:]+}??: 800 allocations (~79.9%)
+//! HEAVY HITTER: test058.cc:8 <- ??{[^:]+}??: 200 allocations (~20.0%)
+//! LEAK CHECK: test058.cc:8 <- ??{[^:]+}??: allocated object ??ptr?? with size 10
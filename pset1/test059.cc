@@ -0,0 +1,52 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Batch allocation and free, with statistics and the leak report.
+
+int main() {
+    void* ptrs[100];
+    size_t n = m61_malloc_batch(100, 48, ptrs, __FILE__, __LINE__);
+    assert(n == 100);
+    for (size_t i = 0; i != n; ++i) {
+        assert(ptrs[i]);
+        memset(ptrs[i], int(i), 48);
+    }
+
+    m61_statistics stat;
+    m61_get_statistics(&stat);
+    assert(stat.nactive == 100);
+    assert(stat.active_size == 4800);
+    assert(stat.ntotal == 100);
+    assert(stat.nactive_by_class[6] == 100);
+
+    // keep one; free the rest, with a NULL in its place
+    void* kept = ptrs[37];
+    ptrs[37] = nullptr;
+    m61_free_batch(ptrs, 100, __FILE__, __LINE__);
+
+    m61_get_statistics(&stat);
+    assert(stat.nactive == 1);
+    assert(stat.active_size == 48);
+    assert(stat.nactive_by_class[6] == 1);
+
+    // batches larger than one internal chunk
+    static void* many[600];
+    assert(m61_malloc_batch(600, 8, many, __FILE__, __LINE__) == 600);
+    m61_free_batch(many, 600, __FILE__, __LINE__);
+    m61_get_statistics(&stat);
+    assert(stat.nactive == 1);
+    assert(stat.ntotal == 700);
+
+    // every failed block counts as a failure
+    void* huge[3];
+    assert(m61_malloc_batch(3, size_t(1) << 50, huge, __FILE__, __LINE__) == 0);
+    m61_get_statistics(&stat);
+    assert(stat.nfail == 3);
+    assert(stat.fail_size == 3 * (1ULL << 50));
+    printf("EXPECTED LEAK: %p\n", kept);
+    m61_print_leak_report();
+}
+
+//! EXPECTED LEAK: ??{0x\w+}=ptr??
+//! LEAK CHECK: test059.cc:9: allocated object ??ptr?? with size 48
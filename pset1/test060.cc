@@ -0,0 +1,15 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Sized free checks the size against the allocation.
+
+int main() {
+    void* p = malloc(100);
+    m61_free_sized(p, 100, __FILE__, __LINE__);
+    void* q = malloc(100);
+    m61_free_sized(q, 96, __FILE__, __LINE__);
+}
+
+//! MEMORY BUG: test060.cc:11: invalid free of pointer ??{0x\w+}??, size 96 does not match allocated size 100
+//! ???
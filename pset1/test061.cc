@@ -0,0 +1,16 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// A batch free finds a double free.
+
+int main() {
+    void* ptrs[10];
+    m61_malloc_batch(10, 24, ptrs, __FILE__, __LINE__);
+    void* dup = ptrs[4];
+    free(dup);
+    m61_free_batch(ptrs, 10, __FILE__, __LINE__);
+}
+
+//! MEMORY BUG: test061.cc:12: invalid free of pointer ??{0x\w+}??, double free
+//! ???
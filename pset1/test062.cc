@@ -0,0 +1,30 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Sites are registered by file pointer, so one file name at two
+// addresses is two sites until a report merges them by name.
+
+static const char file1[] = "shared.cc";
+static char file2[] = "shared.cc";
+
+int main() {
+    unsigned long long snap = m61_snapshot();
+    for (int i = 0; i != 1000; ++i) {
+        void* ptr;
+        if (i % 2 == 0) {
+            ptr = m61_malloc(100, i % 4 == 0 ? file1 : file2, 7);
+        } else {
+            ptr = m61_malloc(1, "light.cc", 1 + i);
+        }
+        if (i % 10 != 0) {
+            m61_free(ptr, "free.cc", 0);
+        }
+    }
+    m61_print_heavy_hitter_report();
+    m61_print_leak_diff(snap);
+}
+
+//! HEAVY HITTER: shared.cc:7: 50000 bytes (~99.0%)
+//! HEAVY HITTER: shared.cc:7: 500 allocations (~50.0%)
+//! LEAK DIFF: shared.cc:7: 100 objects with total size 10000
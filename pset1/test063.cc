@@ -0,0 +1,30 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <sys/mman.h>
+// Memory mapped after the heap is in use is still not in the heap.
+
+int main() {
+    void* small = malloc(100);
+    void* large = malloc(100000);
+    void* page = mmap(nullptr, 4096, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(page != MAP_FAILED);
+    void* later = malloc(100000);
+
+    m61_statistics stat;
+    m61_get_statistics(&stat);
+    void* ptrs[] = {small, large, later};
+    for (void* p : ptrs) {
+        assert((uintptr_t) p >= stat.heap_min && (uintptr_t) p < stat.heap_max);
+    }
+    free(small);
+    free(large);
+    free(later);
+    free(page);
+    m61_print_statistics();
+}
+
+//! MEMORY BUG???: invalid free of pointer ???, not in heap
+//! ???
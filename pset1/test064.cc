@@ -0,0 +1,48 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Pages left empty by a burst of small frees go back to the OS, lazily
+// after enough frees and immediately on m61_trim.
+
+int main() {
+    const int n = 50000;
+    static char* ptrs[n];
+    m61_statistics before, during, after, trimmed;
+    m61_get_statistics(&before);
+    for (int i = 0; i != n; ++i) {
+        ptrs[i] = (char*) malloc(200);
+        assert(ptrs[i]);
+        memset(ptrs[i], 1, 200);
+    }
+    m61_get_statistics(&during);
+    printf("resident grew by at least 8 MiB: %s\n",
+           during.resident_size - before.resident_size >= (8ULL << 20) ? "yes" : "no");
+
+    for (int i = 0; i != n; ++i) {
+        free(ptrs[i]);
+    }
+    m61_get_statistics(&after);
+    printf("resident shrank by at least 2 MiB: %s\n",
+           during.resident_size - after.resident_size >= (2ULL << 20) ? "yes" : "no");
+    m61_trim();
+    m61_get_statistics(&trimmed);
+    printf("trim shrank it further: %s\n",
+           trimmed.resident_size < after.resident_size ? "yes" : "no");
+
+    // released pages are reused, and read as zero
+    for (int i = 0; i != n; ++i) {
+        ptrs[i] = (char*) calloc(1, 200);
+        assert(ptrs[i] && ptrs[i][0] == 0 && ptrs[i][199] == 0);
+    }
+    for (int i = 0; i != n; ++i) {
+        free(ptrs[i]);
+    }
+    m61_print_statistics();
+}
+
+//! resident grew by at least 8 MiB: yes
+//! resident shrank by at least 2 MiB: yes
+//! trim shrank it further: yes
+//! alloc count: active          0   total     100000   fail          0
+//! alloc size:  active          0   total   20000000   fail          0
@@ -0,0 +1,79 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+// Forking while other threads allocate leaves the child a working heap,
+// and a signal handler can write the leak report.
+
+static std::atomic<bool> done;
+
+static void churn(int seed) {
+    void* ptrs[64] = {};
+    for (unsigned i = seed; !done; ++i) {
+        unsigned j = (i * 7) % 64;
+        free(ptrs[j]);
+        ptrs[j] = malloc(1 + (i * 37) % (i % 16 == 0 ? 20000 : 300));
+    }
+    for (void* p : ptrs) {
+        free(p);
+    }
+}
+
+static void child_work() {
+    void* ptrs[100];
+    for (int round = 0; round != 10; ++round) {
+        for (int i = 0; i != 100; ++i) {
+            ptrs[i] = malloc(1 + i * 91);
+            memset(ptrs[i], i, 1 + i * 91);
+        }
+        for (int i = 0; i != 100; ++i) {
+            free(ptrs[i]);
+        }
+    }
+}
+
+static void report(int) {
+    m61_write_leak_report(STDOUT_FILENO);
+}
+
+int main() {
+    std::thread threads[4];
+    for (int i = 0; i != 4; ++i) {
+        threads[i] = std::thread(churn, i);
+    }
+    for (int i = 0; i != 50; ++i) {
+        pid_t p = fork();
+        assert(p >= 0);
+        if (p == 0) {
+            alarm(20);
+            child_work();
+            if (i % 2 == 0) {
+                std::thread t(child_work);
+                t.join();
+            }
+            _exit(0);
+        }
+        int status;
+        assert(waitpid(p, &status, 0) == p);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    done = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    printf("forks ok\n");
+    fflush(stdout);
+
+    void* leak = malloc(32);
+    (void) leak;
+    signal(SIGUSR1, report);
+    raise(SIGUSR1);
+}
+
+//! forks ok
+//! LEAK CHECK: test065.cc:72: allocated object ??{0x\w+}?? with size 32
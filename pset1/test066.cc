@@ -0,0 +1,37 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <csetjmp>
+#include <signal.h>
+// Faults outside the guard pool go to the program's own handler, and
+// guard pages still work after that handler recovers.
+
+static sigjmp_buf recover;
+
+static void on_segv(int) {
+    siglongjmp(recover, 1);
+}
+
+int main() {
+    signal(SIGSEGV, on_segv);
+    m61_set_guard_sampling(1);
+    char* ptr = (char*) malloc(32);
+    for (int i = 0; i != 3; ++i) {
+        if (sigsetjmp(recover, 1) == 0) {
+            *(volatile char*) nullptr = 'A';
+        } else {
+            fprintf(stderr, "recovered %d\n", i);
+        }
+    }
+    for (int i = 0; i <= 32 /* Whoops! Should be < */; ++i) {
+        ptr[i] = 'A';
+    }
+    fprintf(stderr, "Not reached\n");
+}
+
+//! recovered 0
+//! recovered 1
+//! recovered 2
+//! MEMORY BUG: wild access to pointer ???, heap buffer overflow
+//!   test066.cc:19: ??? is 0 bytes past the end of a 32 byte region allocated here
@@ -0,0 +1,26 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include "m61bench.hh"
+// Quarantining a large block poisons only its ends: the free leaves the
+// untouched pages alone, and a write near the end is still caught.
+
+int main() {
+    const size_t sz = 1 << 20;
+    char* p = (char*) malloc(sz);
+    assert(p);
+    size_t before = rss_anon_kb();
+    free(p);
+    printf("free touched under 64 KiB: %s\n",
+           rss_anon_kb() - before < 64 ? "yes" : "no");
+    fflush(stdout);
+
+    p[sz - 10] = 'X';
+    m61_set_quarantine_size(0);
+    printf("should not get here\n");
+}
+
+//! free touched under 64 KiB: yes
+//! MEMORY BUG: test067.cc:14: write after free to pointer ??{0x\w+}??, 1048566 bytes inside a 1048576 byte region freed here
+//! ???
@@ -0,0 +1,19 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+// Arena objects count toward the arena's creation site in the
+// heavy-hitter report.
+
+int main() {
+    m61_arena* a = m61_arena_create(__FILE__, __LINE__);
+    for (int i = 0; i != 1000; ++i) {
+        assert(m61_arena_alloc(a, 100));
+    }
+    free(malloc(10));
+    m61_print_heavy_hitter_report();
+    m61_arena_destroy(a);
+}
+
+//! HEAVY HITTER: test068.cc:9: 100000 bytes (~???%)
+//! HEAVY HITTER: test068.cc:9: 1000 allocations (~???%)
@@ -0,0 +1,32 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <new>
+// Pool objects keep sites whose line needs more than 23 bits, and
+// m61_allocator throws instead of returning a null pointer.
+
+int main() {
+    void* big = m61_pool_alloc(24, "far.cc", 1L << 40);
+    void* small = m61_pool_alloc(24, "near.cc", 12);
+    assert(big && small);
+
+    m61_allocator<int> alloc;
+    bool threw = false;
+    try {
+        alloc.allocate(SIZE_MAX / 2);
+    } catch (std::bad_alloc&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        alloc.allocate(SIZE_MAX / 16);
+    } catch (std::bad_alloc&) {
+        threw = true;
+    }
+    assert(threw);
+    m61_print_leak_report();
+}
+
+//! LEAK CHECK: far.cc:1099511627776: allocated object ??{0x\w+}?? with size 24
+//! LEAK CHECK: near.cc:12: allocated object ??{0x\w+}?? with size 24
@@ -0,0 +1,12 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+// Freeing a pointer that is not the start of a pool slot is reported.
+
+int main() {
+    m61_allocator<long> alloc;
+    long* ptr = alloc.allocate(1);
+    alloc.deallocate(reinterpret_cast<long*>(reinterpret_cast<char*>(ptr) + 16), 1);
+}
+
+//! MEMORY BUG: test070.cc:7: invalid free of pointer ???, not allocated
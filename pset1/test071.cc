@@ -0,0 +1,59 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+#include <set>
+#include <unistd.h>
+// Under the prod policy, which keeps no side table, traced frees still
+// name the allocations they free. (Linked with m61-prod.o.)
+
+int main() {
+    char name[] = "/tmp/m61trace.XXXXXX";
+    int fd = mkstemp(name);
+    assert(fd >= 0);
+    close(fd);
+    void* before = malloc(10);      // allocated before tracing
+    bool ok = m61_trace_open(name, 64);
+    assert(ok);
+
+    void* ptrs[5];
+    for (int i = 0; i != 5; ++i) {
+        ptrs[i] = malloc(10 * (i + 1));
+    }
+    ptrs[0] = realloc(ptrs[0], 100000);
+    void* batch[4];
+    size_t nb = m61_malloc_batch(4, 24, batch, __FILE__, __LINE__);
+    assert(nb == 4);
+    for (int i = 0; i != 5; ++i) {
+        free(ptrs[i]);
+    }
+    m61_free_batch(batch, 4, __FILE__, __LINE__);
+    free(before);
+    m61_trace_close();
+
+    FILE* f = fopen(name, "r");
+    assert(f);
+    m61_trace_header th;
+    size_t n = fread(&th, sizeof(th), 1, f);
+    assert(n == 1 && th.nwritten <= th.capacity);
+    m61_trace_record recs[64];
+    n = fread(recs, sizeof(m61_trace_record), th.nwritten, f);
+    assert(n == th.nwritten);
+    std::set<uint64_t> live;
+    int nalloc = 0, nfree = 0;
+    for (size_t i = 0; i != n; ++i) {
+        if (recs[i].op == m61_trace_free) {
+            assert(live.erase(recs[i].id) == 1);
+            ++nfree;
+        } else {
+            assert(live.insert(recs[i].id).second);
+            ++nalloc;
+        }
+    }
+    printf("%d allocations, %d frees, %zu live\n", nalloc, nfree, live.size());
+    fclose(f);
+    unlink(name);
+}
+
+//! 10 allocations, 10 frees, 0 live
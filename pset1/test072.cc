@@ -0,0 +1,20 @@
+#include "m61.hh"
+#include <cstdio>
+#include <cassert>
+// Each block of a batch has its own birth, so lifetime profiling tells
+// apart frees of blocks from one batch.
+
+int main() {
+    void* ptrs[8];
+    size_t n = m61_malloc_batch(8, 32, ptrs, __FILE__, __LINE__);
+    assert(n == 8);
+    // oldest first: none of these is the youngest live block
+    for (int i = 0; i != 4; ++i) {
+        free(ptrs[i]);
+    }
+    m61_print_lifetime_report();
+    m61_free_batch(ptrs + 4, 4, __FILE__, __LINE__);
+}
+
+//! LIFETIME: test072.cc:9: 8 allocations, 4 frees, size 32-32, 0% LIFO, median 2^??{\d+}?? cycles???
+//! ???
@@ -39,6 +39,17 @@ static std::atomic<unsigned long> ticks; // # timer interrupts so far
 
 pageinfo pages[NPAGES];
 
+// Free pages
+//    Bit `pn % 64` of `free_pages[pn / 64]` is set if physical page `pn`
+//    is allocatable and was free when last checked. Pages can also be
+//    claimed by setting their `refcount` directly, so `kalloc` clears
+//    stale bits as it finds them. Words below `free_pages_hint` are all
+//    zero, so `kalloc` starts its search there.
+
+static uint64_t free_pages[(NPAGES + 63) / 64];
+static size_t free_pages_hint;
+static void init_kalloc();
+
 
 [[noreturn]] void schedule();
 [[noreturn]] void run(proc* p);
@@ -56,6 +67,7 @@ static void process_setup(pid_t pid, const char* program_name);
 void kernel_start(const char* command) {
     // initialize hardware
     init_hardware();
+    init_kalloc();
     log_printf("Starting WeensyOS\n");
 
     ticks = 1;
@@ -95,6 +107,19 @@ void kernel_start(const char* command) {
 }
 
 
+// init_kalloc()
+//    Mark every allocatable, unused physical page as free.
+
+static void init_kalloc() {
+    for (uintptr_t pa = 0; pa != MEMSIZE_PHYSICAL; pa += PAGESIZE) {
+        if (allocatable_physical_address(pa)
+            && !pages[pa / PAGESIZE].used()) {
+            free_pages[pa / PAGESIZE / 64] |= 1UL << (pa / PAGESIZE % 64);
+        }
+    }
+}
+
+
 // kalloc(sz)
 //    Kernel memory allocator. Allocates `sz` contiguous bytes and
 //    returns a pointer to the allocated memory, or `nullptr` on failure.
@@ -107,20 +132,25 @@ void kernel_start(const char* command) {
 //    the allocation fails; if `sz < PAGESIZE` it allocates a whole page
 //    anyway.
 //
-//    The handout code returns the next allocatable free page it can find.
-//    It checks all pages. (You could maybe make this faster!)
+//    `kalloc` returns the lowest-addressed free page, found from the
+//    `free_pages` bitmap one word (64 pages) at a time, starting at the
+//    lowest word that may be nonempty.
 
 void* kalloc(size_t sz) {
     if (sz > PAGESIZE) {
         return nullptr;
     }
 
-    for (uintptr_t pa = 0; pa != MEMSIZE_PHYSICAL; pa += PAGESIZE) {
-        if (allocatable_physical_address(pa)
-            && !pages[pa / PAGESIZE].used()) {
-            ++pages[pa / PAGESIZE].refcount;
-            memset((void*) pa, 0xCC, PAGESIZE);
-            return (void*) pa;
+    for (size_t& w = free_pages_hint; w != arraysize(free_pages); ++w) {
+        while (int bit = lsb(free_pages[w])) {
+            free_pages[w] &= ~(1UL << (bit - 1));
+            uintptr_t pa = (w * 64 + bit - 1) * PAGESIZE;
+            // skip pages claimed without `kalloc`
+            if (!pages[pa / PAGESIZE].used()) {
+                ++pages[pa / PAGESIZE].refcount;
+                memset((void*) pa, 0xCC, PAGESIZE);
+                return (void*) pa;
+            }
         }
     }
     return nullptr;
@@ -129,11 +159,20 @@ void* kalloc(size_t sz) {
 
 // kfree(kptr)
 //    Free `kptr`, which must have been previously returned by `kalloc`.
-//    If `kptr == nullptr` does nothing.
+//    If `kptr == nullptr` does nothing. The page becomes free again once
+//    its last reference is dropped.
 
 void kfree(void* kptr) {
-    (void) kptr;
-    assert(false /* your code here */);
+    if (!kptr) {
+        return;
+    }
+    uintptr_t pa = reinterpret_cast<uintptr_t>(kptr);
+    assert(pa % PAGESIZE == 0 && allocatable_physical_address(pa));
+    assert(pages[pa / PAGESIZE].used());
+    if (--pages[pa / PAGESIZE].refcount == 0) {
+        free_pages[pa / PAGESIZE / 64] |= 1UL << (pa / PAGESIZE % 64);
+        free_pages_hint = min(free_pages_hint, pa / PAGESIZE / 64);
+    }
 }
 
 